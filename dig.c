@@ -4,10 +4,13 @@
  * Software: dig
  * 
  * 
- * Exports mesh and texture data from a given Tomb Raider 1 PHD file.
+ * Exports mesh and texture data from a given Tomb Raider 1 PHD file. The work
+ * is done by libdig (libdig.c, libdig.h); build with e.g.
  * 
- * You should first create the following directory structure under where you
- * run the program:
+ *   gcc -O2 -pthread -o dig dig.c libdig.c
+ * 
+ * The data are exported into the following directory structure, which is
+ * created under where you run the program if it doesn't already exist:
  * 
  *   dig's directory
  *   |
@@ -16,904 +19,916 @@
  *      +- mesh
  *      |  |
  *      |  +- room
+ *      |  |
+ *      |  +- object (with --instanced-statics)
  *      |
  *      +- texture
  *         |
  *         +- atlas
  *         |
- *         +- object
+ *         +- object (or page, with --repack-textures)
+ * 
+ * Given several PHD files or a directory of them, the levels are exported in
+ * parallel, each into its own copy of the above structure under output/, e.g.
+ * output/LEVEL1/mesh/room/.
+ * 
+ * The first time a level file is seen, a table of contents giving where its
+ * sections are is saved next to it (e.g. LEVEL1.PHD.digtoc), so that later runs
+ * can go straight to the data they need.
+ * 
+ * With --incremental, output/manifest.txt records a hash of each exported file,
+ * and on later runs only the files whose contents have changed are rewritten.
  * 
- * Based on the third-party file format documentation available at
- * https://trwiki.earvillage.net/doku.php?id=trs:file_formats.
+ * With --stream, the rooms and textures are decoded and exported a few at a
+ * time, and the level file is let go of as it's read, so that the memory used
+ * doesn't grow with the size of the level file. Given - as the level file, the
+ * level is read from standard input.
+ * 
+ * With --stats, the time taken and the bytes read, allocated and written by each
+ * phase of each level's extraction are saved into a JSON file. With --benchmark,
+ * the levels are exported repeatedly and the fastest phase times printed out,
+ * optionally compared against a saved baseline. Synthetic levels to benchmark
+ * with can be generated with phdgen (phdgen.c).
+ * 
+ * If a level can't be exported, e.g. because its file is malformed, the error is
+ * printed out, the other levels are exported regardless, and the program exits
+ * with a nonzero code.
  *
  */
 
+/* For strdup(), which strict ISO C modes (e.g. -std=c99)
+ * otherwise leave undeclared.*/
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <sys/stat.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <unistd.h>
 #include <stdio.h>
+#include "libdig.h"
 
-/* Placeholder byte sizes of various Tomb Raider data structs.*/
-#define SIZE_TR_ROOM_STATIC_MESH 18
-#define SIZE_TR_CINEMATIC_FRAME 16
-#define SIZE_TR_SPRITE_SEQUENCE 8
-#define SIZE_TR_OBJECT_TEXTURE 20
-#define SIZE_TR_SPRITE_TEXTURE 16
-#define SIZE_TR_MESH_TREE_NODE 4
-#define SIZE_TR_ANIM_DISPATCH 8
-#define SIZE_TR_ANIM_COMMANDS 2
-#define SIZE_TR_SOUND_SOURCE 16
-#define SIZE_TR_STATE_CHANGE 6
-#define SIZE_TR_STATIC_MESH 32
-#define SIZE_TR_ROOM_PORTAL 32
-#define SIZE_TR_ROOM_SECTOR 8
-#define SIZE_TR_ROOM_LIGHT 18
-#define SIZE_TR_ROOM_INFO 16
-#define SIZE_TR_ANIMATION 32
-#define SIZE_TR_ENTITY 22
-#define SIZE_TR_CAMERA 16
-#define SIZE_TR_VERTEX 6
-#define SIZE_TR_MODEL 18
-#define SIZE_TR_FACE4 12
-#define SIZE_TR_FACE3 8
-#define SIZE_TR_BOX 20
-
-struct tr_object_texture_s
+/* A level to be extracted, with the options given for it on the command line.*/
+struct level_job_s
 {
-    unsigned width, height;
-    unsigned hasAlpha;
-    unsigned hasWireframe;
-    unsigned ignoresDepthTest;
-
-    /* UV coordinates for each of the texture's four corners.*/
-    float u[4];
-    float v[4];
-
-    uint8_t *pixelData;
+    const char *inputFilename;
+    char outputPath[MAX_PATH_LENGTH];
+    struct dig_options_s options;
+
+    /* The outcome: a DIG_OK or DIG_ERROR_x value, and the statistics collected
+     * if they were asked for.*/
+    int error;
+    struct dig_stats_s stats;
 };
 
-struct tr_vertex_s
+/* The levels being extracted in parallel, which threads take one at a time.*/
+struct job_queue_s
 {
-    int x, y, z;
-    int lighting;
+    pthread_mutex_t lock;
+    struct level_job_s *jobs;
+    unsigned numJobs;
+    unsigned nextJobIdx;
 };
 
-struct tr_quad_s
+/* Returns true if the given filename has a .PHD extension (in any case).*/
+int is_phd_filename(const char *const filename)
 {
-    struct tr_vertex_s vertex[4];
-    unsigned isDoubleSided;
-    int textureIdx;
-};
+    const size_t length = strlen(filename);
+
+    return ((length > 4) && (strcasecmp((filename + length - 4), ".phd") == 0));
+}
 
-struct tr_triangle_s
+int compare_strings(const void *const a, const void *const b)
 {
-    struct tr_vertex_s vertex[3];
-    unsigned isDoubleSided;
-    int textureIdx;
-};
+    return strcmp(*(const char *const*)a, *(const char *const*)b);
+}
 
-/* The 3d mesh.*/
-struct tr_mesh_s
+/* Adds the given PHD file, or the PHD files in the given directory, to the list
+ * of level filenames. Returns the new number of filenames in the list.*/
+unsigned collect_level_filenames(const char *const path, char ***const filenames, unsigned numFilenames)
 {
-    unsigned numTexturedQuads;
-    struct tr_quad_s *texturedQuads;
+    struct stat pathInfo;
 
-    unsigned numTexturedTriangles;
-    struct tr_triangle_s *texturedTriangles;
+    #define ADD_LEVEL_FILENAME(filename)\
+            *filenames = realloc(*filenames, (sizeof(char*) * (numFilenames + 1)));\
+            assert(*filenames && "Failed to allocate memory for the list of levels.");\
+            (*filenames)[numFilenames++] = strdup(filename);
 
-    unsigned numUntexturedQuads;
-    struct tr_quad_s *untexturedQuads;
+    if ((stat(path, &pathInfo) == 0) && S_ISDIR(pathInfo.st_mode))
+    {
+        const unsigned firstIdx = numFilenames;
+        struct dirent *entry = NULL;
+        DIR *const dir = opendir(path);
 
-    unsigned numUntexturedTriangles;
-    struct tr_triangle_s *untexturedTriangles;
-};
+        assert(dir && "Could not open a directory of PHD files.");
 
-/* Metadata about a 3d mesh.*/
-struct tr_mesh_meta_s
-{
-    /* The object's world coordinates.*/
-    int x, y, z;
+        while ((entry = readdir(dir)))
+        {
+            char filename[MAX_PATH_LENGTH];
 
-    /* Each object can optionally be rotated one or more times by 90 degrees
-     * horizontally.*/
-    unsigned rotation;
+            if (!is_phd_filename(entry->d_name))
+            {
+                continue;
+            }
 
-    /* How light or dark the object is (between 0 = light and 8191 = dark).*/
-    unsigned lighting;
+            snprintf(filename, sizeof(filename), "%s/%s", path, entry->d_name);
+            ADD_LEVEL_FILENAME(filename);
+        }
 
-    /* An index to the master list of room object meshes specifying this object's
-     * mesh.*/
-    unsigned meshIdx;
-};
+        closedir(dir);
 
-/* The 3d mesh of a room.*/
-struct tr_room_mesh_s
+        /* Directory order is arbitrary, so sort it to keep runs reproducible.*/
+        qsort((*filenames + firstIdx), (numFilenames - firstIdx), sizeof(char*), compare_strings);
+    }
+    else
+    {
+        ADD_LEVEL_FILENAME(path);
+    }
+
+    #undef ADD_LEVEL_FILENAME
+
+    return numFilenames;
+}
+
+/* Sets the job's output path to a subdirectory of "output/" named after the
+ * level file, without its extension.*/
+void set_batch_output_path(struct level_job_s *const level)
 {
-    /* The room's world coordinates.*/
-    int x, y, z;
+    const char *baseName = strrchr(level->inputFilename, '/');
+    size_t nameLength = 0;
 
-    unsigned numQuads;
-    struct tr_quad_s *quads;
+    baseName = (baseName? (baseName + 1) : level->inputFilename);
+    nameLength = strlen(baseName);
 
-    unsigned numTriangles;
-    struct tr_triangle_s *triangles;
+    if (is_phd_filename(baseName))
+    {
+        nameLength -= 4;
+    }
 
-    /* In addition to its own geometry, a room may optionally include a number
-     * of static objects.*/
-    unsigned numStaticObjects;
-    struct tr_mesh_meta_s *staticObjects;
-};
+    snprintf(level->outputPath, sizeof(level->outputPath), "output/%.*s/", (int)nameLength, baseName);
 
-struct tr_texture_atlas_s
-{
-    unsigned width, height;
-    uint8_t *pixelData;
-};
+    return;
+}
 
-/* The data we've loaded from the level file (but not necessarily in the same
- * format).*/
-struct imported_data_s
+/* Opens, exports and closes the job's level, keeping its statistics if they're
+ * being collected. Returns DIG_OK or the error that occurred.*/
+int extract_level(struct level_job_s *const job)
 {
-    unsigned fileVersion;
+    struct dig_level_s *level = NULL;
+    int error = DIG_OK;
 
-    uint8_t *palette;
-
-    unsigned numTextureAtlases;
-    struct tr_texture_atlas_s *textureAtlases;
+    if (strcmp(job->inputFilename, "-") == 0)
+    {
+        error = dig_open_stream(&level, STDIN_FILENO, "(standard input)", &job->options);
+    }
+    else
+    {
+        error = dig_open_file(&level, job->inputFilename, &job->options);
+    }
 
-    unsigned numRoomMeshes;
-    struct tr_room_mesh_s *roomMeshes;
+    if (error == DIG_OK)
+    {
+        error = dig_export(level, job->outputPath);
 
-    unsigned numObjectTextures;
-    struct tr_object_texture_s *objectTextures;
+        if (dig_stats(level))
+        {
+            job->stats = *dig_stats(level);
+        }
 
-    /* The master list of meshes.*/
-    unsigned numMeshes;
-    struct tr_mesh_s *meshes;
-};
+        dig_close(level);
+    }
 
-static FILE *INPUT_FILE;
-static struct imported_data_s IMPORTED_DATA;
+    return error;
+}
 
-int32_t read_value(const unsigned numBytes)
+/* Extracts levels from the queue until it's empty.*/
+void* extract_levels_thread(void *const context)
 {
-    int32_t value = 0;
-    size_t read = 0;
+    struct job_queue_s *const queue = context;
 
-    assert((numBytes > 0) && "Can't read a 0-byte value.");
-    assert((numBytes <= sizeof(value)) && "Asked to read a value larger than the input buffer.");
-    
-    read = fread((char*)&value, 1, numBytes, INPUT_FILE);
+    while (1)
+    {
+        struct level_job_s *job = NULL;
 
-    assert((read == numBytes) && "Failed to correctly read from the input file.");
+        pthread_mutex_lock(&queue->lock);
+        if (queue->nextJobIdx < queue->numJobs)
+        {
+            job = &queue->jobs[queue->nextJobIdx++];
+        }
+        pthread_mutex_unlock(&queue->lock);
 
-    return value;
+        if (!job)
+        {
+            break;
+        }
+
+        job->error = extract_level(job);
+
+        if ((job->error == DIG_OK) && job->options.streaming)
+        {
+            printf("Extracted %s into %s (peak RSS %.1f MB)\n", job->inputFilename, job->outputPath,
+                   (job->stats.peakResidentBytes / 1e6));
+        }
+        else if (job->error == DIG_OK)
+        {
+            printf("Extracted %s into %s\n", job->inputFilename, job->outputPath);
+        }
+        else
+        {
+            fprintf(stderr, "%s: %s.\n", job->inputFilename, dig_error_string(job->error));
+        }
+    }
+
+    return NULL;
 }
 
-void read_bytes(char *const dst, const unsigned numBytes)
+/* Extracts the given levels, the given number of them at a time.*/
+void extract_levels(struct level_job_s *const jobs, const unsigned numJobs, const unsigned numThreads)
 {
-    const size_t read = fread(dst, 1, numBytes, INPUT_FILE);
+    const unsigned numWorkers = ((numThreads < numJobs)? numThreads : numJobs);
+    pthread_t *const threads = malloc(sizeof(pthread_t) * numWorkers);
+    struct job_queue_s queue;
+    unsigned numStarted = 0, i = 0;
+
+    assert(threads && "Failed to allocate memory for the threads.");
+
+    pthread_mutex_init(&queue.lock, NULL);
+    queue.jobs = jobs;
+    queue.numJobs = numJobs;
+    queue.nextJobIdx = 0;
+
+    /* The calling thread is one of the workers. If a thread can't be started,
+     * the others take on its share of the jobs.*/
+    for (numStarted = 0; numStarted < (numWorkers - 1); numStarted++)
+    {
+        if (pthread_create(&threads[numStarted], NULL, extract_levels_thread, &queue) != 0)
+        {
+            break;
+        }
+    }
 
-    assert((read == numBytes) && "Failed to correctly read from the input file.");
+    extract_levels_thread(&queue);
+
+    for (i = 0; i < numStarted; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&queue.lock);
+    free(threads);
 
     return;
 }
 
-void skip_num_bytes(const unsigned numBytes)
+/* Prints the given string into the given file as a quoted JSON string.*/
+void print_json_string(FILE *const file, const char *const string)
 {
-    const int seek = fseek(INPUT_FILE, numBytes, SEEK_CUR);
+    const char *c = string;
 
-    assert((seek == 0) && "Failed to correctly seek in the input file.");
+    fputc('"', file);
+
+    for (c = string; *c; c++)
+    {
+        if ((*c == '"') || (*c == '\\')) fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20) fprintf(file, "\\u%04x", (unsigned char)*c);
+        else fputc(*c, file);
+    }
+
+    fputc('"', file);
 
     return;
 }
 
-void print_file_pos(const int offset)
+/* Saves the statistics collected of the given levels' extraction into the given
+ * file as JSON: for each level, its totals and the figures of each phase of
+ * its extraction, in the order in which the phases were run.*/
+void save_stats_report(const char *const filename, const struct level_job_s *const levels, const unsigned numLevels)
 {
-    printf("%ld", (ftell(INPUT_FILE) + offset));
+    unsigned i = 0, p = 0;
+    FILE *const outFile = fopen(filename, "w");
+
+    assert(outFile && "Failed to open the statistics file.");
+
+    fprintf(outFile, "{\n  \"levels\": [");
+
+    for (i = 0; i < numLevels; i++)
+    {
+        const struct dig_stats_s *const stats = &levels[i].stats;
+        struct dig_phase_stats_s total;
+
+        memset(&total, 0, sizeof(total));
+
+        for (p = 0; p < stats->numPhases; p++)
+        {
+            total.numBytesRead += stats->phases[p].numBytesRead;
+            total.numBytesAllocated += stats->phases[p].numBytesAllocated;
+            total.numAllocations += stats->phases[p].numAllocations;
+            total.numBytesWritten += stats->phases[p].numBytesWritten;
+            total.numFilesWritten += stats->phases[p].numFilesWritten;
+            total.numFaces += stats->phases[p].numFaces;
+        }
+
+        #define PRINT_STATS_FIGURES(figures)\
+                fprintf(outFile, "\"seconds\": %.6f, \"bytesRead\": %llu, \"bytesAllocated\": %llu, \"allocations\": %llu, \"bytesWritten\": %llu, \"filesWritten\": %llu, \"faces\": %llu",\
+                        (figures).seconds,\
+                        (unsigned long long)(figures).numBytesRead,\
+                        (unsigned long long)(figures).numBytesAllocated,\
+                        (unsigned long long)(figures).numAllocations,\
+                        (unsigned long long)(figures).numBytesWritten,\
+                        (unsigned long long)(figures).numFilesWritten,\
+                        (unsigned long long)(figures).numFaces);
+
+        total.seconds = stats->seconds;
+
+        fprintf(outFile, "%s\n    {\n      \"file\": ", (i? "," : ""));
+        print_json_string(outFile, levels[i].inputFilename);
+        fprintf(outFile, ",\n      \"output\": ");
+        print_json_string(outFile, levels[i].outputPath);
+        fprintf(outFile, ",\n      \"fileSize\": %llu,\n      \"peakResidentBytes\": %llu,\n      ",
+                (unsigned long long)stats->fileSize, (unsigned long long)stats->peakResidentBytes);
+        PRINT_STATS_FIGURES(total);
+        fprintf(outFile, ",\n      \"phases\": [");
+
+        for (p = 0; p < stats->numPhases; p++)
+        {
+            fprintf(outFile, "%s\n        {\"name\": ", (p? "," : ""));
+            print_json_string(outFile, stats->phases[p].name);
+            fprintf(outFile, ", ");
+            PRINT_STATS_FIGURES(stats->phases[p]);
+            fprintf(outFile, "}");
+        }
+
+        fprintf(outFile, "\n      ]\n    }");
+
+        #undef PRINT_STATS_FIGURES
+    }
+
+    fprintf(outFile, "\n  ]\n}\n");
+    fclose(outFile);
 
     return;
 }
 
-void import_data_from_input_file(void)
+/* A phase's time from a previous benchmark run, as loaded from a baseline file.*/
+struct baseline_entry_s
 {
-    int i = 0, p = 0;
+    char *level;
+    char *phase;
+    double seconds;
+};
+
+/* Loads the phase times saved into the given baseline file by an earlier
+ * benchmark run. Each of the file's lines gives a level file's name, a phase
+ * name and the phase's time in seconds, separated by tabs. Returns the number
+ * of entries loaded, or 0 if there's no such file.*/
+unsigned load_benchmark_baseline(const char *const filename, struct baseline_entry_s **const entries)
+{
+    char line[MAX_PATH_LENGTH * 2];
+    unsigned numEntries = 0;
+    FILE *const inFile = fopen(filename, "r");
 
-    IMPORTED_DATA.fileVersion = (uint32_t)read_value(4);
+    *entries = NULL;
 
-    assert((IMPORTED_DATA.fileVersion == 32) && "Expected a Tomb Raider 1 level file.");
+    if (!inFile)
+    {
+        return 0;
+    }
 
-    /* Read textures.*/
+    while (fgets(line, sizeof(line), inFile))
     {
-        IMPORTED_DATA.numTextureAtlases = read_value(4);
-        IMPORTED_DATA.textureAtlases = malloc(sizeof(struct tr_texture_atlas_s) * IMPORTED_DATA.numTextureAtlases);
+        char *const phase = strchr(line, '\t');
+        char *const seconds = (phase? strchr((phase + 1), '\t') : NULL);
 
-        for (i = 0; i < IMPORTED_DATA.numTextureAtlases; i++)
+        if (!seconds)
         {
-            unsigned numPixels;
+            continue;
+        }
 
-            IMPORTED_DATA.textureAtlases[i].width = 256;
-            IMPORTED_DATA.textureAtlases[i].height = 256;
-            numPixels = (IMPORTED_DATA.textureAtlases[i].width * IMPORTED_DATA.textureAtlases[i].height);
+        *phase = *seconds = '\0';
 
-            IMPORTED_DATA.textureAtlases[i].pixelData = malloc(numPixels);
-            read_bytes((char*)IMPORTED_DATA.textureAtlases[i].pixelData, numPixels);
-        }
+        *entries = realloc(*entries, (sizeof(struct baseline_entry_s) * (numEntries + 1)));
+        assert(*entries && "Failed to allocate memory for the benchmark baseline.");
+
+        (*entries)[numEntries].level = strdup(line);
+        (*entries)[numEntries].phase = strdup(phase + 1);
+        (*entries)[numEntries].seconds = strtod((seconds + 1), NULL);
+        numEntries++;
     }
 
-    /* Skip unknown dword.*/
-    skip_num_bytes(4);
+    fclose(inFile);
 
-    /* Read rooms.*/
-    {
-        IMPORTED_DATA.numRoomMeshes = read_value(2);
-        print_file_pos(-2);printf(" Rooms: %d\n", IMPORTED_DATA.numRoomMeshes);
+    return numEntries;
+}
 
-        IMPORTED_DATA.roomMeshes = malloc(sizeof(struct tr_room_mesh_s) * IMPORTED_DATA.numRoomMeshes);
+/* Returns the baseline time of the given level's given phase, or a negative
+ * value if the baseline doesn't have it.*/
+double find_baseline_seconds(const struct baseline_entry_s *const entries,
+                             const unsigned numEntries,
+                             const char *const level,
+                             const char *const phase)
+{
+    unsigned i = 0;
 
-        for (i = 0; i < IMPORTED_DATA.numRoomMeshes; i++)
+    for (i = 0; i < numEntries; i++)
+    {
+        if ((strcmp(entries[i].level, level) == 0) &&
+            (strcmp(entries[i].phase, phase) == 0))
         {
-            unsigned numRoomDataWords = 0;
-            unsigned numPortals = 0;
-            unsigned numZSectors = 0;
-            unsigned numXSectors = 0;
-            int ambientIntensity = 0;
-            unsigned numLights = 0;
-            unsigned alternateRoom = 0;
-            int16_t flags = 0;
+            return entries[i].seconds;
+        }
+    }
 
-            print_file_pos(0);printf("   #%d\n", i);
+    return -1;
+}
 
-            /* Room info.*/
-            IMPORTED_DATA.roomMeshes[i].x = read_value(4);
-            IMPORTED_DATA.roomMeshes[i].z = read_value(4);
-            skip_num_bytes(4); /* Skip 'yBottom'.*/
-            skip_num_bytes(4); /* Skip 'yTop'.   */
+/* Prints out one row of the benchmark results: the time taken, the throughput
+ * in megabytes (read plus written) and in faces per second, and how the time
+ * compares with the baseline's.*/
+void print_benchmark_row(const char *const name, const struct dig_phase_stats_s *const figures, const double baselineSeconds)
+{
+    const double seconds = ((figures->seconds > 0)? figures->seconds : 1e-9);
 
-            /* Room data.*/
-            {
-                char *rawRoomMeshData = NULL;
+    printf("  %-28s %10.3f %10.1f", name, (figures->seconds * 1000),
+           ((figures->numBytesRead + figures->numBytesWritten) / seconds / 1e6));
 
-                numRoomDataWords = read_value(4);
-                print_file_pos(-2);printf("     Room data size: %d\n", numRoomDataWords);
+    if (figures->numFaces) printf(" %12.0f", (figures->numFaces / seconds));
+    else printf(" %12s", "-");
 
-                rawRoomMeshData = malloc(numRoomDataWords * 2);
-                read_bytes(rawRoomMeshData, (numRoomDataWords * 2));
+    if (baselineSeconds > 0) printf(" %+8.1f%%\n", (((figures->seconds - baselineSeconds) / baselineSeconds) * 100));
+    else printf(" %9s\n", "-");
 
-                /* Parse the raw room mesh data.*/
-                {
-                    struct tr_vertex_s *vertexList = NULL;
-                    const int16_t *roomDataIterator = (int16_t*)&(rawRoomMeshData[0]);
-
-                    /* Vertex list.*/
-                    {
-                        const unsigned numVertices = *roomDataIterator++;
-                        print_file_pos(0);printf("       Vertices: %d\n", numVertices);
-
-                        vertexList = malloc(sizeof(struct tr_vertex_s) * numVertices);
-
-                        for (p = 0; p < numVertices; p++)
-                        {
-                            vertexList[p].x = (*roomDataIterator++ + IMPORTED_DATA.roomMeshes[i].x);
-                            vertexList[p].y = *roomDataIterator++;
-                            vertexList[p].z = (*roomDataIterator++ + IMPORTED_DATA.roomMeshes[i].z);
-                            vertexList[p].lighting = *roomDataIterator++;
-                        }
-                    }
-
-                    /* Quads.*/
-                    {
-                        IMPORTED_DATA.roomMeshes[i].numQuads = *roomDataIterator++;
-                        print_file_pos(0);printf("       Quads: %d\n", IMPORTED_DATA.roomMeshes[i].numQuads);
-
-                        IMPORTED_DATA.roomMeshes[i].quads = malloc(sizeof(struct tr_quad_s) * IMPORTED_DATA.roomMeshes[i].numQuads);
-
-                        for (p = 0; p < IMPORTED_DATA.roomMeshes[i].numQuads; p++)
-                        {
-                            IMPORTED_DATA.roomMeshes[i].quads[p].vertex[0] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].quads[p].vertex[1] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].quads[p].vertex[2] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].quads[p].vertex[3] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].quads[p].textureIdx = *roomDataIterator++;
-
-                            IMPORTED_DATA.roomMeshes[i].quads[p].isDoubleSided = (IMPORTED_DATA.roomMeshes[i].quads[p].textureIdx & 0x8000);
-                            IMPORTED_DATA.roomMeshes[i].quads[p].textureIdx = (IMPORTED_DATA.roomMeshes[i].quads[p].textureIdx & 0x7fff);
-                        }
-                    }
-
-                    /* Triangles.*/
-                    {
-                        IMPORTED_DATA.roomMeshes[i].numTriangles = *roomDataIterator++;
-                        print_file_pos(0);printf("       Triangles: %d\n", IMPORTED_DATA.roomMeshes[i].numTriangles);
-
-                        IMPORTED_DATA.roomMeshes[i].triangles = malloc(sizeof(struct tr_triangle_s) * IMPORTED_DATA.roomMeshes[i].numTriangles);
-
-                        for (p = 0; p < IMPORTED_DATA.roomMeshes[i].numTriangles; p++)
-                        {
-                            IMPORTED_DATA.roomMeshes[i].triangles[p].vertex[0] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].triangles[p].vertex[1] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].triangles[p].vertex[2] = vertexList[*roomDataIterator++];
-                            IMPORTED_DATA.roomMeshes[i].triangles[p].textureIdx = *roomDataIterator++;
-
-                            IMPORTED_DATA.roomMeshes[i].triangles[p].isDoubleSided = (IMPORTED_DATA.roomMeshes[i].triangles[p].textureIdx & 0x8000);
-                            IMPORTED_DATA.roomMeshes[i].triangles[p].textureIdx = (IMPORTED_DATA.roomMeshes[i].triangles[p].textureIdx & 0x7fff);
-                        }
-                    }
-
-                    free(vertexList);
-                }
+    return;
+}
 
-                free(rawRoomMeshData);
-            }
+/* Extracts each of the given levels the given number of times, one level at a
+ * time, and prints out the fastest time of each phase of each level along with
+ * its throughput. If the given baseline file exists, the times are compared
+ * against those in it; otherwise, they're saved into it. The levels' stats are
+ * left holding the fastest times. Levels that fail to extract are left out.*/
+void run_benchmark(struct level_job_s *const levels,
+                   const unsigned numLevels,
+                   const unsigned numRuns,
+                   const char *const baselineFilename)
+{
+    struct baseline_entry_s *baseline = NULL;
+    unsigned numBaselineEntries = 0;
+    FILE *baselineFile = NULL;
+    unsigned i = 0, p = 0, run = 0;
 
-            /* Portals.*/
-            numPortals = read_value(2);
-            print_file_pos(-2);printf("     Portals: %d\n", numPortals);
-            skip_num_bytes(SIZE_TR_ROOM_PORTAL * numPortals);
-
-            /* Sectors.*/
-            numZSectors = read_value(2);
-            numXSectors = read_value(2);
-            print_file_pos(-4);printf("     Sectors: %d, %d\n", numZSectors, numXSectors);
-            skip_num_bytes(SIZE_TR_ROOM_SECTOR * numZSectors * numXSectors);
-
-            /* Lights.*/
-            ambientIntensity = (int16_t)read_value(2);
-            numLights = read_value(2);
-            print_file_pos(-4);printf("     Lights: %d (%d)\n", numLights, ambientIntensity);
-            skip_num_bytes(SIZE_TR_ROOM_LIGHT * numLights);
-
-            /* Static room meshes.*/
-            IMPORTED_DATA.roomMeshes[i].numStaticObjects = read_value(2);
-            print_file_pos(-2);printf("     Static meshes: %d\n", IMPORTED_DATA.roomMeshes[i].numStaticObjects);
-            IMPORTED_DATA.roomMeshes[i].staticObjects = malloc(sizeof(struct tr_mesh_meta_s) * IMPORTED_DATA.roomMeshes[i].numStaticObjects);
-            for (p = 0; p < IMPORTED_DATA.roomMeshes[i].numStaticObjects; p++)
-            {
-                IMPORTED_DATA.roomMeshes[i].staticObjects[p].x = read_value(4);
-                IMPORTED_DATA.roomMeshes[i].staticObjects[p].y = read_value(4);
-                IMPORTED_DATA.roomMeshes[i].staticObjects[p].z = read_value(4);
-                IMPORTED_DATA.roomMeshes[i].staticObjects[p].rotation = ((read_value(2) & 0xc000) >> 14);
-                IMPORTED_DATA.roomMeshes[i].staticObjects[p].lighting = read_value(2);
-                IMPORTED_DATA.roomMeshes[i].staticObjects[p].meshIdx = read_value(2);
-            }
+    if (baselineFilename)
+    {
+        numBaselineEntries = load_benchmark_baseline(baselineFilename, &baseline);
 
-            /* Miscellaneous.*/
-            alternateRoom = read_value(2);
-            flags = read_value(2);
-            print_file_pos(-2);printf("     Alternate room: %d\n", alternateRoom);
-            print_file_pos(-2);printf("     Flags: 0x%x\n", flags);
+        if (!numBaselineEntries)
+        {
+            baselineFile = fopen(baselineFilename, "w");
+            assert(baselineFile && "Failed to open the benchmark baseline file.");
         }
     }
 
-    /* Read floors.*/
+    for (i = 0; i < numLevels; i++)
     {
-        const unsigned numFloors = read_value(4);
-        skip_num_bytes(numFloors * 2);
-    }
+        struct dig_stats_s *const stats = &levels[i].stats;
+        struct dig_phase_stats_s best[DIG_MAX_STATS_PHASES];
+        struct dig_phase_stats_s total;
+        unsigned numPhases = 0;
+        double bestSeconds = 0;
 
-    /* Read meshes.*/
-    {
-        /* The raw mesh data array.*/
-        char *meshData = NULL;
-        unsigned meshDataLength = 0;
-        int16_t *meshDataIterator = NULL; /* For iterating through and extracting values from the array.*/
-
-        /* Offsets to the raw mesh data array of objects' mesh data.*/
-        unsigned *meshOffsets = NULL;
-
-        meshDataLength = (read_value(4) * 2);
-        meshData = malloc(meshDataLength);
-        read_bytes(meshData, meshDataLength);
-
-        IMPORTED_DATA.numMeshes = read_value(4);
-        print_file_pos(0);printf(" Meshes: %d\n", IMPORTED_DATA.numMeshes);
-        IMPORTED_DATA.meshes = malloc(sizeof(struct tr_mesh_s) * IMPORTED_DATA.numMeshes);
-        meshOffsets = malloc(sizeof(meshOffsets) * IMPORTED_DATA.numMeshes);
-        read_bytes((char*)meshOffsets, (sizeof(uint32_t) * IMPORTED_DATA.numMeshes));
-
-        /* Extract individual meshes from the raw mesh data array.*/
-        for (i = 0; i < IMPORTED_DATA.numMeshes; i++)
-        {
-            struct tr_mesh_s *const objectMesh = &IMPORTED_DATA.meshes[i];
-            struct tr_vertex_s *vertexList = NULL;
-            int numVertices = 0;
-            int numNormals = 0;
-
-            meshDataIterator = (int16_t*)(meshData + meshOffsets[i]);
-
-            /* Skip vertex 'center'.*/
-            meshDataIterator += (SIZE_TR_VERTEX / 2);
-
-            /* Skip uint32_t collisionRadius.*/
-            meshDataIterator += (sizeof(uint32_t) / 2);
-            
-            numVertices = *meshDataIterator++;
-            vertexList = malloc(sizeof(struct tr_vertex_s) * numVertices);
-            for (p = 0; p < numVertices; p++)
+        for (run = 0; run < numRuns; run++)
+        {
+            if ((levels[i].error = extract_level(&levels[i])) != DIG_OK)
             {
-                vertexList[p].x = *meshDataIterator++;
-                vertexList[p].y = *meshDataIterator++;
-                vertexList[p].z = *meshDataIterator++;
-                vertexList[p].lighting = 0; /* Object meshes have no pre-baked lighting.*/
+                break;
             }
 
-            numNormals = *meshDataIterator++;
-            if (numNormals > 0) /* Normals*/
+            assert(((run == 0) || (stats->numPhases == numPhases)) && "The benchmark runs differ in their phases.");
+
+            for (p = 0; p < stats->numPhases; p++)
             {
-                for (p = 0; p < numNormals; p++)
+                if ((run == 0) || (stats->phases[p].seconds < best[p].seconds))
                 {
-                    const int x = *meshDataIterator++;
-                    const int y = *meshDataIterator++;
-                    const int z = *meshDataIterator++;
-
-                    /* Convert into a floating-point normal vector.*/
-                    const float nx = (x / 16384.0);
-                    const float ny = (y / 16384.0);
-                    const float nz = (z / 16384.0);
-
-                    /* Normals aren't exported anywhere at the moment, so let's just ignore them.*/
-                    (void)nx;
-                    (void)ny;
-                    (void)nz;
+                    best[p] = stats->phases[p];
                 }
             }
-            else /* Lights.*/
+
+            if ((run == 0) || (stats->seconds < bestSeconds))
             {
-                numNormals = abs(numNormals);
-                for (p = 0; p < numNormals; p++)
-                {
-                    meshDataIterator++;
-                }
+                bestSeconds = stats->seconds;
             }
 
-            #define LOAD_OBJECT_MESH_FACES(dstMeshArray, numFaces, numVertsPerFace)\
-                    dstMeshArray = malloc(sizeof(struct tr_quad_s) * numFaces);\
-                    for (p = 0; p < numFaces; p++)\
-                    {\
-                        unsigned v = 0;\
-                        for (v = 0; v < numVertsPerFace; v++)\
-                        {\
-                            const unsigned vertexIdx = *meshDataIterator++;\
-                            assert((vertexIdx < numVertices) && "Invalid vertex list index.");\
-                            dstMeshArray[p].vertex[v] = vertexList[vertexIdx];\
-                        }\
-                        dstMeshArray[p].textureIdx = *meshDataIterator++;\
-                    }
+            numPhases = stats->numPhases;
+        }
+
+        if (levels[i].error != DIG_OK)
+        {
+            fprintf(stderr, "%s: %s.\n", levels[i].inputFilename, dig_error_string(levels[i].error));
+            continue;
+        }
 
-            objectMesh->numTexturedQuads = *meshDataIterator++;
-            LOAD_OBJECT_MESH_FACES(objectMesh->texturedQuads, objectMesh->numTexturedQuads, 4);
+        memcpy(stats->phases, best, (sizeof(struct dig_phase_stats_s) * numPhases));
+        stats->seconds = bestSeconds;
 
-            objectMesh->numTexturedTriangles = *meshDataIterator++;
-            LOAD_OBJECT_MESH_FACES(objectMesh->texturedTriangles, objectMesh->numTexturedTriangles, 3);
+        /* The whole extraction's throughput is that of the level file, and of
+         * the most faces that any one phase processed.*/
+        memset(&total, 0, sizeof(total));
+        total.seconds = bestSeconds;
+        total.numBytesRead = stats->fileSize;
 
-            objectMesh->numUntexturedQuads = *meshDataIterator++;
-            LOAD_OBJECT_MESH_FACES(objectMesh->untexturedQuads, objectMesh->numUntexturedQuads, 4);
+        printf("%s (%.2f MB), fastest of %u run(s):\n", levels[i].inputFilename, (stats->fileSize / 1e6), numRuns);
+        printf("  %-28s %10s %10s %12s %9s\n", "phase", "ms", "MB/s", "faces/s", "change");
 
-            objectMesh->numUntexturedTriangles = *meshDataIterator++;
-            LOAD_OBJECT_MESH_FACES(objectMesh->untexturedTriangles, objectMesh->numUntexturedTriangles, 3);
+        for (p = 0; p < numPhases; p++)
+        {
+            print_benchmark_row(best[p].name, &best[p],
+                                find_baseline_seconds(baseline, numBaselineEntries, levels[i].inputFilename, best[p].name));
 
-            #undef LOAD_OBJECT_MESH_FACES
+            total.numFaces = ((best[p].numFaces > total.numFaces)? best[p].numFaces : total.numFaces);
 
-            free(vertexList);
+            if (baselineFile)
+            {
+                fprintf(baselineFile, "%s\t%s\t%.6f\n", levels[i].inputFilename, best[p].name, best[p].seconds);
+            }
         }
 
-        free(meshOffsets);
-        free(meshData);
-    }
+        print_benchmark_row("total", &total, find_baseline_seconds(baseline, numBaselineEntries, levels[i].inputFilename, "total"));
 
-    /* Read animations.*/
-    {
-        const unsigned numAnimations = read_value(4);
-        print_file_pos(-4);printf(" Animations: %d\n", numAnimations);
-        skip_num_bytes(SIZE_TR_ANIMATION * numAnimations);
+        if (baselineFile)
+        {
+            fprintf(baselineFile, "%s\t%s\t%.6f\n", levels[i].inputFilename, "total", bestSeconds);
+        }
     }
 
-    /* Read state changes.*/
+    if (baselineFile)
     {
-        const unsigned numStateChanges = read_value(4);
-        print_file_pos(-4);printf(" State changes: %d\n", numStateChanges);
-        skip_num_bytes(SIZE_TR_STATE_CHANGE * numStateChanges);
+        fclose(baselineFile);
+        printf("Saved the times as the baseline into %s.\n", baselineFilename);
     }
 
-    /* Read animation dispatches.*/
+    for (i = 0; i < numBaselineEntries; i++)
     {
-        const unsigned numAnimationDispatches = read_value(4);
-        print_file_pos(-4);printf(" Animation dispatches: %d\n", numAnimationDispatches);
-        skip_num_bytes(SIZE_TR_ANIM_DISPATCH * numAnimationDispatches);
+        free(baseline[i].level);
+        free(baseline[i].phase);
     }
 
-    /* Read animation commands.*/
-    {
-        const unsigned numAnimationCommands = read_value(4);
-        print_file_pos(-4);printf(" Animation commands: %d\n", numAnimationCommands);
-        skip_num_bytes(SIZE_TR_ANIM_COMMANDS * numAnimationCommands);
-    }
+    free(baseline);
 
-    /* Read mesh trees.*/
-    {
-        const unsigned numMeshTrees = read_value(4);
-        print_file_pos(-4);printf(" Mesh trees: %d\n", numMeshTrees);
-        skip_num_bytes(SIZE_TR_MESH_TREE_NODE * numMeshTrees);
-    }
+    return;
+}
 
-    /* Read frames.*/
-    {
-        const unsigned numFrames = read_value(4);
-        print_file_pos(-4);printf(" Frames: %d\n", numFrames);
-        skip_num_bytes(numFrames * 2);
-    }
+void print_usage(const char *const programName)
+{
+    printf("Usage: %s [options] <PHD filename or directory> [...]\n"
+           "\n"
+           "Given a single PHD file, exports it under output/. Given several PHD\n"
+           "files or a directory of them, exports each level in parallel under\n"
+           "output/<level name>/. Given -, reads the level from standard input.\n"
+           "\n"
+           "  -j <threads>            Number of threads to use. Defaults to the\n"
+           "                          number of CPU cores.\n"
+           "  --mesh-format <format>  Export room meshes as 'trm' (text; the\n"
+           "                          default), 'trb' (binary, indexed), 'obj'\n"
+           "                          (Wavefront .obj/.mtl) or 'glb' (the whole\n"
+           "                          level as a single glTF 2.0 binary file,\n"
+           "                          mesh/level.glb). Can be given more than\n"
+           "                          once.\n"
+           "  --texture-format <format>\n"
+           "                          Export textures as 'trt' (raw palette\n"
+           "                          indices; the default), 'png' (indexed-color),\n"
+           "                          'png-rgba', 'rgba' (raw 32-bit RGBA) or 'tra'\n"
+           "                          (all textures' palette indices in a single\n"
+           "                          memory-mappable archive, texture/textures.tra).\n"
+           "                          Can be given more than once.\n"
+           "  --dedup-textures        Export each distinct object texture image\n"
+           "                          only once, into texture/image/, along with\n"
+           "                          an index.txt giving each object texture's\n"
+           "                          image.\n"
+           "  --repack-textures       Repack the object textures' images into a\n"
+           "                          few power-of-two texture pages, exported\n"
+           "                          into texture/page/, and have the meshes'\n"
+           "                          textured faces refer to the pages, for one\n"
+           "                          material per page. Can't be used with\n"
+           "                          --dedup-textures.\n"
+           "  --rooms <list>          Export only the given rooms, e.g. '3,17-20',\n"
+           "                          and only the object textures they use.\n"
+           "  --textures              Export only textures, not room meshes.\n"
+           "  --meshes-only           Export only room meshes, not textures.\n"
+           "  --no-atlases            Don't export the texture atlases.\n"
+           "  --no-toc                Don't read or write a table of contents\n"
+           "                          (<PHD filename>.digtoc) next to each level\n"
+           "                          file for finding its sections quickly.\n"
+           "  --instanced-statics     Export each mesh used by the rooms' static\n"
+           "                          objects only once, into mesh/object/, and\n"
+           "                          list each room's static objects as instances\n"
+           "                          of them in mesh/room/<room>.instances.\n"
+           "  --incremental           Only write the output files whose contents\n"
+           "                          have changed since the previous export, as\n"
+           "                          recorded in the output's manifest.txt, and\n"
+           "                          list the files that were written.\n"
+           "  --stream                Decode and export the rooms and textures a\n"
+           "                          few at a time, so that the memory used\n"
+           "                          doesn't grow with the size of the level\n"
+           "                          file, and print out the peak resident set\n"
+           "                          size. Can't be used with 'glb'.\n"
+           "  -v, --verbose           Print out each section of the level file as\n"
+           "                          it's being read.\n"
+           "  --stats <file>          Save into the given file, as JSON, how long\n"
+           "                          each phase of importing and exporting each\n"
+           "                          level took, and how many bytes it read,\n"
+           "                          allocated and wrote.\n"
+           "  --benchmark <runs>      Export each level the given number of times,\n"
+           "                          one level at a time, and print out the\n"
+           "                          fastest time of each phase along with its\n"
+           "                          throughput in MB/s and faces/s.\n"
+           "  --baseline <file>       With --benchmark, compare the times against\n"
+           "                          those saved in the given file; or if there's\n"
+           "                          no such file, save the times into it.\n", programName);
 
-    /* Read models.*/
-    {
-        const unsigned numModels = read_value(4);
-        print_file_pos(-4);printf(" Models: %d\n", numModels);
-        skip_num_bytes(SIZE_TR_MODEL * numModels);
-    }
+    return;
+}
 
-    /* Read static meshes.*/
+int main(int argc, char *argv[])
+{
+    char **levelFilenames = NULL;
+    unsigned numLevels = 0;
+    unsigned numThreads = 0;
+    unsigned isBatch = 0;
+    struct level_job_s *levels = NULL;
+    struct dig_options_s settings; /* The options given on the command line, for all levels.*/
+    unsigned texturesOnly = 0, meshesOnly = 0, noAtlases = 0;
+    const char *statsFilename = NULL;
+    const char *baselineFilename = NULL;
+    unsigned numBenchmarkRuns = 0;
+    int exitCode = 0;
+    int i = 0;
+
+    dig_default_options(&settings);
+    numThreads = settings.numThreads;
+    settings.meshFormats = 0;
+    settings.textureFormats = 0;
+
+    for (i = 1; i < argc; i++)
     {
-        const unsigned numStaticMeshes = read_value(4);
-        print_file_pos(-4);printf(" Static meshes: %d\n", numStaticMeshes);
-        for (i = 0; i < numStaticMeshes; i++)
-        {
-            const unsigned staticMeshId = read_value(4); /* A value identifying this static mesh.*/
-            const unsigned meshIdx = read_value(2);      /* Index to the master list of meshes (IMPORTED_DATA.meshes).*/
-            skip_num_bytes(12); /* Skip 'visibilityBox'.*/
-            skip_num_bytes(12); /* Skip 'collisionBox'. */
-            skip_num_bytes(2);  /* Skip 'flags'.        */
-
-            /* Route the master mesh index information directly to the room's static
-             * objects. Normally, the static objects have an index referring to this
-             * metadata, which then refers to the master mesh list.*/
-            for (p = 0; p < IMPORTED_DATA.numRoomMeshes; p++)
+        if (strcmp(argv[i], "-j") == 0)
+        {
+            if (((i + 1) >= argc) || (atoi(argv[i+1]) < 1))
             {
-                unsigned k = 0;
-
-                for (k = 0; k < IMPORTED_DATA.roomMeshes[p].numStaticObjects; k++)
-                {
-                    if (IMPORTED_DATA.roomMeshes[p].staticObjects[k].meshIdx == staticMeshId)
-                    {
-                        IMPORTED_DATA.roomMeshes[p].staticObjects[k].meshIdx = meshIdx;
-                    }
-                }
+                print_usage(argv[0]);
+                return 1;
             }
-        }
-    }
 
-    /* Read object texture metadata.*/
-    {
-        IMPORTED_DATA.numObjectTextures = read_value(4);
-        print_file_pos(-4);printf(" Object textures: %d\n", IMPORTED_DATA.numObjectTextures);
-
-        IMPORTED_DATA.objectTextures = malloc(sizeof(struct tr_object_texture_s) * IMPORTED_DATA.numObjectTextures);
-
-        for (i = 0; i < IMPORTED_DATA.numObjectTextures; i++)
+            numThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--mesh-format") == 0)
         {
-            struct tr_object_texture_s *const texture = &IMPORTED_DATA.objectTextures[i];
-            unsigned textureAtlasIdx = 0;
-            unsigned isTriangle = 0;
-            unsigned attribute = 0;
-
-            attribute = read_value(2);
-            textureAtlasIdx = read_value(2);
-            isTriangle = (textureAtlasIdx & 0x1);
-            textureAtlasIdx = (textureAtlasIdx & 0x7fff);
-            texture->hasAlpha = ((attribute == 1) || (attribute == 4));
-            texture->ignoresDepthTest = (attribute == 4);
-            texture->hasWireframe = (attribute == 6);
+            const char *const format = (((i + 1) < argc)? argv[++i] : "");
 
-            assert((textureAtlasIdx < IMPORTED_DATA.numTextureAtlases) && "Texture atlas index out of bounds.");
-
-            /* Copy the texture's data from the texture atlas.*/
+            if (strcmp(format, "trm") == 0) settings.meshFormats |= MESH_FORMAT_TRM;
+            else if (strcmp(format, "trb") == 0) settings.meshFormats |= MESH_FORMAT_TRB;
+            else if (strcmp(format, "obj") == 0) settings.meshFormats |= MESH_FORMAT_OBJ;
+            else if (strcmp(format, "glb") == 0) settings.meshFormats |= MESH_FORMAT_GLB;
+            else
             {
-                unsigned minX = ~0u, maxX = 0, minY = ~0u, maxY = 0;
-                unsigned cornerPoints[4][2] = {0}; /* 4 texel coordinate pairs defining this texture's rectangle in the texture atlas.*/
-
-                for (p = 0; p < 4; p++)
-                {
-                    const unsigned x = read_value(2);
-                    const unsigned y = read_value(2);
-
-                    cornerPoints[p][0] = (unsigned)((x & 0xff00) / 256.0);
-                    cornerPoints[p][1] = (unsigned)((y & 0xff00) / 256.0);
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dedup-textures") == 0)
+        {
+            settings.dedupTextures = 1;
+        }
+        else if (strcmp(argv[i], "--repack-textures") == 0)
+        {
+            settings.repackTextures = 1;
+        }
+        else if (strcmp(argv[i], "--rooms") == 0)
+        {
+            if ((i + 1) >= argc)
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
 
-                    texture->u[3-p] = ((x & 0xff) / 256.0);
-                    texture->v[3-p] = ((y & 0xff) / 256.0);
-                }
+            settings.roomList = argv[++i];
+        }
+        else if (strcmp(argv[i], "--textures") == 0)
+        {
+            texturesOnly = 1;
+        }
+        else if (strcmp(argv[i], "--meshes-only") == 0)
+        {
+            meshesOnly = 1;
+        }
+        else if (strcmp(argv[i], "--no-atlases") == 0)
+        {
+            noAtlases = 1;
+        }
+        else if (strcmp(argv[i], "--no-toc") == 0)
+        {
+            settings.useToc = 0;
+        }
+        else if (strcmp(argv[i], "--instanced-statics") == 0)
+        {
+            settings.instancedStatics = 1;
+        }
+        else if (strcmp(argv[i], "--incremental") == 0)
+        {
+            settings.incremental = 1;
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            settings.streaming = 1;
+        }
+        else if ((strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "--verbose") == 0))
+        {
+            settings.verbose = 1;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            if ((i + 1) >= argc)
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
 
-                for (p = 0; p < (isTriangle? 3 : 4); p++)
-                {
-                    if (cornerPoints[p][0] > maxX) maxX = cornerPoints[p][0];
-                    if (cornerPoints[p][0] < minX) minX = cornerPoints[p][0];
+            statsFilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0)
+        {
+            if (((i + 1) >= argc) || (atoi(argv[i+1]) < 1))
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
 
-                    if (cornerPoints[p][1] > maxY) maxY = cornerPoints[p][1];
-                    if (cornerPoints[p][1] < minY) minY = cornerPoints[p][1];
-                }
-                
-                texture->width = ((maxX - minX) + 1);
-                texture->height = ((maxY - minY) + 1);
-                texture->pixelData = malloc(texture->width * texture->height);
+            numBenchmarkRuns = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--baseline") == 0)
+        {
+            if ((i + 1) >= argc)
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
 
-                /* Copy the pixel data row by row.*/
-                for (p = 0; p < texture->height; p++)
-                {
-                    const unsigned srcIdx = (minX + (minY + p) * IMPORTED_DATA.textureAtlases[textureAtlasIdx].width);
-                    const unsigned dstIdx = (p * texture->width);
+            baselineFilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--texture-format") == 0)
+        {
+            const char *const format = (((i + 1) < argc)? argv[++i] : "");
+
+            if (strcmp(format, "trt") == 0) settings.textureFormats |= TEXTURE_FORMAT_TRT;
+            else if (strcmp(format, "png") == 0) settings.textureFormats |= TEXTURE_FORMAT_PNG;
+            else if (strcmp(format, "png-rgba") == 0) settings.textureFormats |= TEXTURE_FORMAT_PNG_RGBA;
+            else if (strcmp(format, "rgba") == 0) settings.textureFormats |= TEXTURE_FORMAT_RGBA;
+            else if (strcmp(format, "tra") == 0) settings.textureFormats |= TEXTURE_FORMAT_ARCHIVE;
+            else
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
 
-                    memcpy((texture->pixelData + dstIdx),
-                           (IMPORTED_DATA.textureAtlases[textureAtlasIdx].pixelData + srcIdx),
-                           texture->width);
-                }
+            if ((settings.textureFormats & TEXTURE_FORMAT_PNG) &&
+                (settings.textureFormats & TEXTURE_FORMAT_PNG_RGBA))
+            {
+                fprintf(stderr, "Only one of the PNG texture formats can be used at a time.\n");
+                return 1;
             }
         }
-    }
+        else if ((argv[i][0] == '-') && (strcmp(argv[i], "-") != 0))
+        {
+            /* E.g. --help or a misspelled option, rather than a level file.*/
+            print_usage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            struct stat pathInfo;
 
-    /* Read sprite textures.*/
-    {
-        const unsigned numSpriteTextures = read_value(4);
-        print_file_pos(-4);printf(" Sprite textures: %d\n", numSpriteTextures);
-        skip_num_bytes(SIZE_TR_SPRITE_TEXTURE * numSpriteTextures);
-    }
+            if ((strcmp(argv[i], "-") != 0) &&
+                (stat(argv[i], &pathInfo) == 0) && S_ISDIR(pathInfo.st_mode))
+            {
+                isBatch = 1;
+            }
 
-    /* Read sprite sequences.*/
-    {
-        const unsigned numSpriteSequences = read_value(4);
-        print_file_pos(-4);printf(" Sprite sequences: %d\n", numSpriteSequences);
-        skip_num_bytes(SIZE_TR_SPRITE_SEQUENCE * numSpriteSequences);
+            numLevels = collect_level_filenames(argv[i], &levelFilenames, numLevels);
+        }
     }
 
-    /* Read cameras.*/
+    if (!numLevels)
     {
-        const unsigned numCameras = read_value(4);
-        print_file_pos(-4);printf(" Cameras: %d\n", numCameras);
-        skip_num_bytes(SIZE_TR_CAMERA * numCameras);
+        print_usage(argv[0]);
+        return 1;
     }
 
-    /* Read sound sources.*/
-    {
-        const unsigned numSoundSources = read_value(4);
-        print_file_pos(-4);printf(" Sound sources: %d\n", numSoundSources);
-        skip_num_bytes(SIZE_TR_SOUND_SOURCE * numSoundSources);
-    }
+    isBatch = (isBatch || (numLevels > 1));
 
-    /* Read boxes and overlaps.*/
+    if (!settings.meshFormats)
     {
-        unsigned numBoxes = 0;
-        unsigned numOverlaps = 0;
-        
-        numBoxes = read_value(4);
-        print_file_pos(-4);printf(" Boxes: %d\n", numBoxes);
-        skip_num_bytes(SIZE_TR_BOX * numBoxes);
-
-        numOverlaps = read_value(4);
-        print_file_pos(-4);printf(" Overlaps: %d\n", numBoxes);
-        skip_num_bytes(numOverlaps * 2);
-
-        skip_num_bytes(numBoxes * 2); /* groundZone     */
-        skip_num_bytes(numBoxes * 2); /* groundZone2    */
-        skip_num_bytes(numBoxes * 2); /* flyZone        */
-        skip_num_bytes(numBoxes * 2); /* groundZoneAlt  */
-        skip_num_bytes(numBoxes * 2); /* groundZoneAlt2 */
-        skip_num_bytes(numBoxes * 2); /* flyZoneAlt     */
+        settings.meshFormats = MESH_FORMAT_TRM;
     }
 
-    /* Read animated textures.*/
+    if (!settings.textureFormats)
     {
-        const unsigned numAnimatedTextures = read_value(4);
-        print_file_pos(-4);printf(" Animated textures: %d\n", numAnimatedTextures);
-        skip_num_bytes(numAnimatedTextures * 2);
+        settings.textureFormats = TEXTURE_FORMAT_TRT;
     }
 
-    /* Read entities.*/
+    if (texturesOnly && meshesOnly)
     {
-        const unsigned numEntities = read_value(4);
-        print_file_pos(-4);printf(" Entities: %d\n", numEntities);
-        skip_num_bytes(SIZE_TR_ENTITY * numEntities);
+        fprintf(stderr, "Only one of --textures and --meshes-only can be given.\n");
+        return 1;
     }
 
-    /* Read lightmap.*/
+    if (baselineFilename && !numBenchmarkRuns)
     {
-        skip_num_bytes(8192);
+        fprintf(stderr, "--baseline can only be given with --benchmark.\n");
+        return 1;
     }
 
-    /* Read palette.*/
-    {
-        IMPORTED_DATA.palette = malloc(768);
-        read_bytes((char*)IMPORTED_DATA.palette, 768);
-
-        for (i = 0; i < 768; i++)
-        {
-            /* Convert colors from VGA 6-bit to full 8-bit.*/
-            IMPORTED_DATA.palette[i] = (IMPORTED_DATA.palette[i] * 4);
-        }
-    }
+    if (texturesOnly) settings.exportParts &= ~EXPORT_ROOM_MESHES;
+    if (meshesOnly) settings.exportParts &= ~(EXPORT_TEXTURE_ATLASES | EXPORT_OBJECT_TEXTURES);
+    if (noAtlases) settings.exportParts &= ~EXPORT_TEXTURE_ATLASES;
 
-    /* Read cinematic frames.*/
+    if (settings.streaming && (settings.meshFormats & MESH_FORMAT_GLB))
     {
-        const unsigned numCinematicFrames = read_value(2);
-        print_file_pos(-2);printf(" Cinematic frames: %d\n", numCinematicFrames);
-        skip_num_bytes(SIZE_TR_CINEMATIC_FRAME * numCinematicFrames);
+        fprintf(stderr, "--stream can't be used with the 'glb' mesh format.\n");
+        return 1;
     }
 
-    /* Read demo data.*/
+    if (settings.repackTextures && settings.dedupTextures)
     {
-        const unsigned numDemoData = read_value(2);
-        print_file_pos(-2);printf(" Demo data: %d\n", numDemoData);
-        skip_num_bytes(numDemoData);
+        fprintf(stderr, "--repack-textures can't be used with --dedup-textures.\n");
+        return 1;
     }
 
-    /* Skip the rest of the file (sound data).*/
-    /* Skip the rest of the file (sound data).*/
-    /* Skip the rest of the file (sound data).*/
+    /* In streaming mode, the peak memory use is reported.*/
+    settings.collectStats = (statsFilename || numBenchmarkRuns || settings.streaming);
 
-    return;
-}
+    levels = calloc(numLevels, sizeof(struct level_job_s));
+    assert(levels && "Failed to allocate memory for the list of levels.");
 
-void export_imported_data(void)
-{
-    int i = 0, p = 0;
-
-    /* Save the level's palette.*/
+    for (i = 0; i < (int)numLevels; i++)
     {
-        FILE *outFile = fopen("output/texture/palette.pal", "wb");
-        assert(outFile && "Failed to open an output file for exporting the palette.");
+        int p = 0;
 
-        fwrite((char*)IMPORTED_DATA.palette, 1, 768, outFile);
+        levels[i].options = settings;
+        levels[i].inputFilename = levelFilenames[i];
 
-        fclose(outFile);
-    }
+        /* Levels being processed in parallel share the threads between them.
+         * When benchmarking, they're processed one at a time.*/
+        levels[i].options.numThreads = ((numThreads > numLevels)? (numThreads / numLevels) : 1);
+        if (numBenchmarkRuns) levels[i].options.numThreads = numThreads;
 
-    /* Save textures.*/
-    {
-        #define SAVE_TEXTURE(path, texture)\
-                FILE *outFile, *metaFile;\
-                char filename[256];\
-                const unsigned numPixels = (texture.width * texture.height);\
-                \
-                sprintf(filename, "%s%d.trt", path, i);\
-                outFile = fopen(filename, "wb");\
-                \
-                sprintf(filename, "%s%d.trt.mta", path, i);\
-                metaFile = fopen(filename, "wb");\
-                \
-                assert((outFile && metaFile) && "Failed to open an output file to export a texture into.");\
-                \
-                fwrite((char*)texture.pixelData, 1, numPixels, outFile);\
-                \
-                fprintf(metaFile, "%d %d", texture.width, texture.height);\
-                \
-                fclose(outFile);\
-                fclose(metaFile);\
-
-        /* Save the texture atlases.*/
-        {
-            for (i = 0; i < IMPORTED_DATA.numTextureAtlases; i++)
+        if (isBatch)
+        {
+            set_batch_output_path(&levels[i]);
+
+            for (p = 0; p < i; p++)
             {
-                SAVE_TEXTURE("output/texture/atlas/", IMPORTED_DATA.textureAtlases[i]);
+                if (strcmp(levels[i].outputPath, levels[p].outputPath) == 0)
+                {
+                    fprintf(stderr, "Levels %s and %s would both be exported into %s.\n",
+                            levels[p].inputFilename, levels[i].inputFilename, levels[i].outputPath);
+                    return 1;
+                }
             }
         }
-
-        /* Save the object textures.*/
+        else
         {
-            for (i = 0; i < IMPORTED_DATA.numObjectTextures; i++)
-            {
-                SAVE_TEXTURE("output/texture/object/", IMPORTED_DATA.objectTextures[i]);
-            }
+            strcpy(levels[i].outputPath, "output/");
         }
-
-        #undef SAVE_TEXTURE
     }
 
-    /* Save the room meshes.*/
+    if (numBenchmarkRuns)
     {
-        #define SAVE_ROOM_FACES(numFaces, faceData, numVertsPerFace, facesAreTextured) \
-                for (j = 0; j < numFaces; j++)\
-                {\
-                    int v = 0;\
-                    \
-                    sprintf(tmp, "%d %d", numVertsPerFace, (facesAreTextured? faceData[j].textureIdx : -(faceData[j].textureIdx & 0xff)));\
-                    fputs(tmp, outFile);\
-                    \
-                    for (v = 0; v < numVertsPerFace; v++)\
-                    {\
-                        sprintf(tmp, " %d %d %d %f %f", faceData[j].vertex[v].x,\
-                                                        faceData[j].vertex[v].y,\
-                                                        faceData[j].vertex[v].z,\
-                                                        IMPORTED_DATA.objectTextures[faceData[j].textureIdx].u[v],\
-                                                        IMPORTED_DATA.objectTextures[faceData[j].textureIdx].v[v]);\
-                        \
-                        fputs(tmp, outFile);\
-                    }\
-                    \
-                    fputs("\n", outFile);\
-                }\
-
-        #define SAVE_ROOM_OBJECT_FACES(numFaces, faceData, metaData, numVertsPerFace, facesAreTextured) \
-                for (j = 0; j < numFaces; j++)\
-                {\
-                    int v = 0;\
-                    \
-                    sprintf(tmp, "%d %d", numVertsPerFace, (facesAreTextured? faceData[j].textureIdx : -(faceData[j].textureIdx & 0xff)));\
-                    fputs(tmp, outFile);\
-                    \
-                    for (v = 0; v < numVertsPerFace; v++)\
-                    {\
-                        int r = 0;\
-                        \
-                        int x = faceData[j].vertex[v].x;\
-                        int y = faceData[j].vertex[v].y;\
-                        int z = faceData[j].vertex[v].z;\
-                        \
-                        /* Rotate the vertex.*/\
-                        for (r = 0; r < metaData->rotation; r++)\
-                        {\
-                            int tmp = x;\
-                            x = z;\
-                            z = -tmp;\
-                        }\
-                        \
-                        sprintf(tmp, " %d %d %d %f %f", (x + metaData->x),\
-                                                        (y + metaData->y),\
-                                                        (z + metaData->z),\
-                                                        IMPORTED_DATA.objectTextures[faceData[j].textureIdx].u[v],\
-                                                        IMPORTED_DATA.objectTextures[faceData[j].textureIdx].v[v]);\
-                        \
-                        fputs(tmp, outFile);\
-                    }\
-                    \
-                    fputs("\n", outFile);\
-                }\
-                
-        for (i = 0; i < IMPORTED_DATA.numRoomMeshes; i++)
-        {
-            unsigned j = 0;
-            FILE *outFile;
-            char tmp[256];
-            char meshFileName[256];
-
-            sprintf(meshFileName, "output/mesh/room/%d.trm", i);
-
-            outFile = fopen(meshFileName, "wb");
-            assert(outFile && "Failed to open an output file to export a mesh into.");
-
-            /* Save the room's mesh.*/
-            SAVE_ROOM_FACES(IMPORTED_DATA.roomMeshes[i].numQuads, IMPORTED_DATA.roomMeshes[i].quads, 4, 1);
-            SAVE_ROOM_FACES(IMPORTED_DATA.roomMeshes[i].numTriangles, IMPORTED_DATA.roomMeshes[i].triangles, 3, 1);
-
-            /* Save the room's static objects' meshes.*/
-            for (p = 0; p < IMPORTED_DATA.roomMeshes[i].numStaticObjects; p++)
-            {
-                const struct tr_mesh_meta_s *const objectMeta = &IMPORTED_DATA.roomMeshes[i].staticObjects[p];
-                const struct tr_mesh_s *const object = &IMPORTED_DATA.meshes[objectMeta->meshIdx];
-
-                SAVE_ROOM_OBJECT_FACES(object->numTexturedQuads, object->texturedQuads, objectMeta, 4, 1);
-                SAVE_ROOM_OBJECT_FACES(object->numTexturedTriangles, object->texturedTriangles, objectMeta, 3, 1);
-                SAVE_ROOM_OBJECT_FACES(object->numUntexturedQuads, object->untexturedQuads, objectMeta, 4, 0);
-                SAVE_ROOM_OBJECT_FACES(object->numUntexturedTriangles, object->untexturedTriangles, objectMeta, 3, 0);
-            }
-        }
-
-        #undef SAVE_ROOM_FACES
-        #undef SAVE_ROOM_OBJECT_FACES
+        run_benchmark(levels, numLevels, numBenchmarkRuns, baselineFilename);
+    }
+    else
+    {
+        extract_levels(levels, numLevels, numThreads);
     }
 
-    return;
-}
+    if (statsFilename)
+    {
+        save_stats_report(statsFilename, levels, numLevels);
+    }
 
-int main(int argc, char *argv[])
-{
-    if (argc != 2)
+    for (i = 0; i < (int)numLevels; i++)
     {
-        printf("Usage: %s <PHD filename>\n", argv[0]);
-        return 1;
+        if (levels[i].error != DIG_OK)
+        {
+            exitCode = 1;
+        }
+
+        free(levelFilenames[i]);
     }
-    
-    INPUT_FILE = fopen(argv[1], "rb");
-    assert(INPUT_FILE && "Could not open the PHD file.");
 
-    import_data_from_input_file();
-    export_imported_data();
+    free(levelFilenames);
+    free(levels);
 
-    return 0;
+    return exitCode;
 }
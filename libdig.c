@@ -0,0 +1,7247 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft
+ * 
+ * Software: libdig
+ * 
+ * 
+ * Imports mesh and texture data from Tomb Raider 1 PHD level files and exports
+ * them into various formats. See libdig.h for the interface.
+ * 
+ * The first time a level file is opened, a table of contents giving where its
+ * sections are is saved next to it (e.g. LEVEL1.PHD.digtoc), so that later runs
+ * can go straight to the data they need.
+ * 
+ * In incremental mode, <output path>/manifest.txt records a hash of each
+ * exported file, and on later exports only the files whose contents have
+ * changed are rewritten.
+ * 
+ * Errors in the level file or in writing the output are recorded in the level's
+ * context as they happen, from whichever thread they happen on, and returned
+ * from the interface functions. Assertions are only made of the code's own
+ * invariants, and of memory allocations succeeding.
+ * 
+ * Based on the third-party file format documentation available at
+ * https://trwiki.earvillage.net/doku.php?id=trs:file_formats.
+ *
+ */
+
+/* For strdup(), mkstemp() and madvise(), which strict ISO C modes (e.g. -std=c99)
+ * otherwise leave undeclared.*/
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include "libdig.h"
+
+/* Static objects' vertices are transformed four at a time where SSE2 is available.*/
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+/* On x86 with GCC or Clang, palette expansion uses AVX2 when the CPU has it.*/
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+    #include <immintrin.h>
+    #define HAS_AVX2_KERNELS
+#endif
+
+/* Placeholder byte sizes of various Tomb Raider data structs.*/
+#define SIZE_TR_ROOM_STATIC_MESH 18
+#define SIZE_TR_CINEMATIC_FRAME 16
+#define SIZE_TR_SPRITE_SEQUENCE 8
+#define SIZE_TR_OBJECT_TEXTURE 20
+#define SIZE_TR_SPRITE_TEXTURE 16
+#define SIZE_TR_MESH_TREE_NODE 4
+#define SIZE_TR_ANIM_DISPATCH 8
+#define SIZE_TR_ANIM_COMMANDS 2
+#define SIZE_TR_SOUND_SOURCE 16
+#define SIZE_TR_STATE_CHANGE 6
+#define SIZE_TR_STATIC_MESH 32
+#define SIZE_TR_ROOM_PORTAL 32
+#define SIZE_TR_ROOM_SECTOR 8
+#define SIZE_TR_ROOM_LIGHT 18
+#define SIZE_TR_ROOM_INFO 16
+#define SIZE_TR_ANIMATION 32
+#define SIZE_TR_ENTITY 22
+#define SIZE_TR_CAMERA 16
+#define SIZE_TR_VERTEX 6
+#define SIZE_TR_ROOM_VERTEX 8
+#define SIZE_TR_ROOM_QUAD 10
+#define SIZE_TR_ROOM_TRIANGLE 8
+#define SIZE_TR_MODEL 18
+#define SIZE_TR_FACE4 12
+#define SIZE_TR_FACE3 8
+#define SIZE_TR_BOX 20
+
+/* The size of the buffers through which text files are written.*/
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/* The texture formats (TEXTURE_FORMAT_x flags) that are written as is, and those
+ * that are encoded as PNG.*/
+#define RAW_TEXTURE_FORMATS (TEXTURE_FORMAT_TRT | TEXTURE_FORMAT_RGBA)
+#define PNG_TEXTURE_FORMATS (TEXTURE_FORMAT_PNG | TEXTURE_FORMAT_PNG_RGBA)
+
+/* In streaming mode, how many rooms per thread are decoded and exported at a
+ * time. Bounds the memory taken by the rooms' geometry.*/
+#define STREAM_ROOMS_PER_THREAD 4
+
+/* In streaming mode, how far the reading of the level file gets between letting
+ * the kernel drop the pages behind it, and how far back from where the pages
+ * were last dropped they're dropped again. On a page fault, the kernel maps in
+ * the file's cached pages around the faulting one (by default, 64 KB of them),
+ * including some that may already have been dropped.*/
+#define STREAM_RELEASE_INTERVAL (1024 * 1024)
+#define STREAM_RELEASE_OVERLAP (256 * 1024)
+
+/* How many object textures each export task saves. The textures are small, so
+ * they're handed out in batches to keep the task pool's overhead down; texture
+ * atlases get a task each.*/
+#define EXPORT_TEXTURES_PER_TASK 8
+
+/* Texture pages, into which the texture images are repacked, are squares of at
+ * most this many pixels a side, cut down to the smallest power-of-two size that
+ * their images fit in.*/
+#define TEXTURE_PAGE_MAX_SIZE 1024
+
+/* How many pixels of each texture image's edges are repeated around it on its
+ * texture page, so that filtering doesn't bleed in the neighboring images.*/
+#define TEXTURE_PAGE_PADDING 2
+
+#define TEXTURE_PAGE_NONE (~0u)
+
+/* Arena allocations are aligned to this many bytes.*/
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGNED_SIZE(numBytes) ((((numBytes) + (ARENA_ALIGNMENT - 1)) / ARENA_ALIGNMENT) * ARENA_ALIGNMENT)
+
+/* The smallest block the arena allocates at a time.*/
+#define ARENA_MIN_BLOCK_SIZE (256 * 1024)
+
+/* The sections of a level file, in file order, as recorded in its table of
+ * contents. Sections after the demo data (the sound data) aren't recorded.*/
+#define LEVEL_SECTION_TEXTURE_ATLASES 0
+#define LEVEL_SECTION_ROOMS 1
+#define LEVEL_SECTION_FLOORS 2
+#define LEVEL_SECTION_MESH_DATA 3
+#define LEVEL_SECTION_MESH_POINTERS 4
+#define LEVEL_SECTION_ANIMATIONS 5
+#define LEVEL_SECTION_STATE_CHANGES 6
+#define LEVEL_SECTION_ANIMATION_DISPATCHES 7
+#define LEVEL_SECTION_ANIMATION_COMMANDS 8
+#define LEVEL_SECTION_MESH_TREES 9
+#define LEVEL_SECTION_FRAMES 10
+#define LEVEL_SECTION_MODELS 11
+#define LEVEL_SECTION_STATIC_MESHES 12
+#define LEVEL_SECTION_OBJECT_TEXTURES 13
+#define LEVEL_SECTION_SPRITE_TEXTURES 14
+#define LEVEL_SECTION_SPRITE_SEQUENCES 15
+#define LEVEL_SECTION_CAMERAS 16
+#define LEVEL_SECTION_SOUND_SOURCES 17
+#define LEVEL_SECTION_BOXES 18
+#define LEVEL_SECTION_OVERLAPS 19
+#define LEVEL_SECTION_ZONES 20
+#define LEVEL_SECTION_ANIMATED_TEXTURES 21
+#define LEVEL_SECTION_ENTITIES 22
+#define LEVEL_SECTION_LIGHT_MAP 23
+#define LEVEL_SECTION_PALETTE 24
+#define LEVEL_SECTION_CINEMATIC_FRAMES 25
+#define LEVEL_SECTION_DEMO_DATA 26
+#define NUM_LEVEL_SECTIONS 27
+
+/* Identifies a table of contents file, followed by its format version.*/
+#define TOC_FILE_MAGIC "DTOC"
+#define TOC_FILE_VERSION 2
+
+/* How many bytes of the level file are hashed at each of its start, middle and
+ * end to tell whether the file has changed since its table of contents was
+ * saved.*/
+#define TOC_SAMPLE_SIZE 4096
+
+struct tr_object_texture_s
+{
+    unsigned width, height;
+    unsigned hasAlpha;
+    unsigned hasWireframe;
+    unsigned ignoresDepthTest;
+
+    /* UV coordinates for each of the texture's four corners, on the texture's
+     * image; or if the textures have been repacked, on its texture page.*/
+    float u[4];
+    float v[4];
+
+    /* The texture's pixels, shared with other object textures that cover the
+     * same rectangle of the same atlas. An index to the level's list of unique
+     * texture images.*/
+    unsigned imageIdx;
+    const uint8_t *pixelData;
+};
+
+/* A mesh's vertices, shared by its faces. Stored as parallel arrays so that
+ * passes over the vertices walk memory linearly.*/
+struct tr_vertex_buffer_s
+{
+    unsigned numVertices;
+    int32_t *x, *y, *z;
+
+    /* Pre-baked vertex lighting; NULL for meshes that don't have any.*/
+    int16_t *lighting;
+};
+
+/* Faces refer to their vertices by index into the mesh's vertex buffer.*/
+struct tr_quad_s
+{
+    uint16_t vertexIdx[4];
+    uint16_t isDoubleSided;
+    int16_t textureIdx;
+};
+
+struct tr_triangle_s
+{
+    uint16_t vertexIdx[3];
+    uint16_t isDoubleSided;
+    int16_t textureIdx;
+};
+
+/* The 3d mesh.*/
+struct tr_mesh_s
+{
+    struct tr_vertex_buffer_s vertices;
+
+    unsigned numTexturedQuads;
+    struct tr_quad_s *texturedQuads;
+
+    unsigned numTexturedTriangles;
+    struct tr_triangle_s *texturedTriangles;
+
+    unsigned numUntexturedQuads;
+    struct tr_quad_s *untexturedQuads;
+
+    unsigned numUntexturedTriangles;
+    struct tr_triangle_s *untexturedTriangles;
+};
+
+/* Metadata about a 3d mesh.*/
+struct tr_mesh_meta_s
+{
+    /* The object's world coordinates.*/
+    int x, y, z;
+
+    /* Each object can optionally be rotated one or more times by 90 degrees
+     * horizontally.*/
+    unsigned rotation;
+
+    /* How light or dark the object is (between 0 = light and 8191 = dark).*/
+    unsigned lighting;
+
+    /* An index to the master list of room object meshes specifying this object's
+     * mesh.*/
+    unsigned meshIdx;
+
+    /* The mesh's vertices rotated and moved into the object's place in the world.
+     * Only set up when the object is baked into its room's exported meshes.*/
+    struct tr_vertex_buffer_s vertices;
+};
+
+/* The 3d mesh of a room.*/
+struct tr_room_mesh_s
+{
+    /* The room's world coordinates.*/
+    int x, y, z;
+
+    /* The room's vertices, in world coordinates.*/
+    struct tr_vertex_buffer_s vertices;
+
+    unsigned numQuads;
+    struct tr_quad_s *quads;
+
+    unsigned numTriangles;
+    struct tr_triangle_s *triangles;
+
+    /* In addition to its own geometry, a room may optionally include a number
+     * of static objects.*/
+    unsigned numStaticObjects;
+    struct tr_mesh_meta_s *staticObjects;
+};
+
+/* A rectangle of pixels cut out of a texture atlas. Object textures that cover
+ * the same rectangle share a single image.*/
+struct tr_texture_image_s
+{
+    unsigned atlasIdx;
+    unsigned x, y;
+    unsigned width, height;
+    uint8_t *pixelData;
+
+    /* Where the image has been repacked: the texture page's index, or
+     * TEXTURE_PAGE_NONE if the textures haven't been repacked, and the image's
+     * top left corner on the page.*/
+    unsigned pageIdx;
+    unsigned pageX, pageY;
+};
+
+/* A power-of-two texture into which texture images have been repacked, so that
+ * the faces using any of them can share a single material.*/
+struct tr_texture_page_s
+{
+    unsigned width, height;
+    uint8_t *pixelData;
+};
+
+struct tr_texture_atlas_s
+{
+    unsigned width, height;
+
+    /* Points directly into the memory-mapped level file.*/
+    const uint8_t *pixelData;
+};
+
+/* The data we've loaded from the level file (but not necessarily in the same
+ * format).*/
+struct imported_data_s
+{
+    unsigned fileVersion;
+
+    uint8_t *palette;
+
+    unsigned numTextureAtlases;
+    struct tr_texture_atlas_s *textureAtlases;
+
+    unsigned numRoomMeshes;
+    struct tr_room_mesh_s *roomMeshes;
+
+    unsigned numObjectTextures;
+    struct tr_object_texture_s *objectTextures;
+
+    /* The distinct rectangles of the texture atlases used by the object textures.*/
+    unsigned numTextureImages;
+    struct tr_texture_image_s *textureImages;
+
+    /* The pages into which the texture images have been repacked, if they have.*/
+    unsigned numTexturePages;
+    struct tr_texture_page_s *texturePages;
+
+    /* Which rooms, object textures and texture images have been selected for
+     * export, one flag per element of the corresponding list above. Rooms that
+     * aren't selected aren't decoded, and texture images that aren't selected
+     * aren't copied out of their atlas (their pixelData is NULL).*/
+    uint8_t *roomIsSelected;
+    uint8_t *objectTextureIsSelected;
+    uint8_t *textureImageIsSelected;
+
+    /* The master list of meshes. Only the meshes used by the selected rooms'
+     * static objects (those whose flag is set) are decoded.*/
+    unsigned numMeshes;
+    struct tr_mesh_s *meshes;
+    uint8_t *meshIsSelected;
+};
+
+/* A bounds-checked read position in a block of little-endian data, e.g. in the
+ * memory-mapped level file or in a section thereof.*/
+struct data_cursor_s
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+
+    /* Set once a read or seek has gone past the end of the data, after which
+     * reads give zeros.*/
+    unsigned failed;
+};
+
+/* A bump allocator from which all of a level's imported data are allocated, so
+ * that they can be released in one go once the level is closed. Safe
+ * to allocate from concurrently.*/
+struct arena_s
+{
+    pthread_mutex_t lock;
+    struct arena_block_s *blocks; /* The block being allocated from, followed by the full ones.*/
+
+    /* How much has been allocated from the arena so far.*/
+    uint64_t numBytesAllocated;
+    uint64_t numAllocations;
+};
+
+struct arena_block_s
+{
+    struct arena_block_s *next;
+    size_t size;
+    size_t used;
+    uint8_t *data;
+};
+
+/* Where a section of the level file begins (its first element, past the count
+ * that precedes it), and how many elements it has.*/
+struct level_section_s
+{
+    size_t offset;
+    unsigned count;
+};
+
+/* Where each of a level file's sections and rooms are, as found by a pass over
+ * the file or as loaded from the file's table of contents sidecar.*/
+struct level_toc_s
+{
+    /* Identify the level file that the table of contents is for, as it was
+     * when the table was made: its size, its modification time and file serial
+     * number as given by stat(), and a hash of a few samples of its contents.*/
+    uint64_t fileSize;
+    uint64_t modifiedSeconds;
+    uint64_t modifiedNanoseconds;
+    uint64_t inode;
+    uint64_t device;
+    uint64_t sampleHash;
+    size_t numBytesSampled;
+
+    /* Whether the table was loaded from the level's sidecar file rather than
+     * found by walking through the level file.*/
+    unsigned isLoaded;
+
+    struct level_section_s sections[NUM_LEVEL_SECTIONS];
+
+    /* One entry per room.*/
+    struct room_index_s *rooms;
+};
+
+/* The statistics being collected of a level. Its running totals of the output
+ * written can be added to by any of the level's threads.*/
+struct level_stats_s
+{
+    struct dig_stats_s report;
+
+    pthread_mutex_t lock;
+    uint64_t numBytesWritten;
+    uint64_t numFilesWritten;
+    uint64_t numFaces;
+
+    /* The time and running totals when the current phase began.*/
+    double phaseStartTime;
+    struct dig_phase_stats_s phaseStart;
+};
+
+/* The first error that has occurred in importing or exporting a level; any of
+ * the level's threads can record one.*/
+struct level_error_s
+{
+    pthread_mutex_t lock;
+    int code; /* A DIG_ERROR_x value, or DIG_OK if there's been no error.*/
+};
+
+/* The state of extracting a single level. Levels share no state with each other,
+ * so any number of them can be extracted in parallel.*/
+struct level_s
+{
+    /* The level file's name; or for a level opened from memory, the name it was
+     * given, if any.*/
+    const char *inputFilename;
+
+    /* The directory (with a trailing slash) under which the level's output tree
+     * is created.*/
+    char outputPath[MAX_PATH_LENGTH];
+
+    /* Whether to print out the level's sections as they're being read.*/
+    unsigned verbose;
+
+    /* How many threads the level may use to process its data in parallel.*/
+    unsigned numThreads;
+
+    /* The formats (MESH_FORMAT_x flags) in which to export the room meshes.*/
+    unsigned meshFormats;
+
+    /* The formats (TEXTURE_FORMAT_x flags) in which to export the textures.*/
+    unsigned textureFormats;
+
+    /* Whether to export each distinct object texture image only once, into
+     * texture/image/, instead of once per object texture into texture/object/.*/
+    unsigned dedupTextures;
+
+    /* Whether to repack the texture images into texture pages, exported into
+     * texture/page/ instead of texture/object/, with the meshes' textured faces
+     * referring to the pages.*/
+    unsigned repackTextures;
+
+    /* The parts of the level (EXPORT_x flags) to export.*/
+    unsigned exportParts;
+
+    /* The rooms to export, as a list of indices and index ranges (e.g. "3,17-20");
+     * or NULL to export all of them. Only the object textures that the selected
+     * rooms use are then exported.*/
+    const char *roomList;
+
+    /* Whether to export each mesh used by the rooms' static objects only once,
+     * into mesh/object/, with each room listing its static objects as instances
+     * thereof, instead of baking the objects into the rooms' meshes.*/
+    unsigned instancedStatics;
+
+    /* Whether to use (and if need be, write) a table of contents sidecar next to
+     * the level file, so that the file needn't be walked through to find its
+     * sections.*/
+    unsigned useToc;
+
+    /* Whether to decode the rooms and object textures only as they're exported,
+     * a few at a time, rather than importing them all up front.*/
+    unsigned streaming;
+
+    /* In incremental mode, the manifest of the files exported on the previous
+     * run; otherwise NULL.*/
+    unsigned incremental;
+    struct output_manifest_s *manifest;
+
+    /* The statistics being collected of the level's extraction; or NULL if
+     * they're not being collected.*/
+    struct level_stats_s *stats;
+
+    /* Where errors in importing or exporting the level are recorded.*/
+    struct level_error_s *error;
+
+    /* The level file's data; memory-mapped by the level itself if isMapped is
+     * set, otherwise owned by the caller.*/
+    struct data_cursor_s inputFile;
+    unsigned isMapped;
+
+    struct level_toc_s toc;
+    struct imported_data_s importedData;
+
+    /* Holds the memory of importedData.*/
+    struct arena_s arena;
+
+    /* Holds the memory of the decoded rooms' geometry and static objects: the
+     * level's arena, or in streaming mode, one that's emptied after each batch
+     * of rooms has been exported.*/
+    struct arena_s *roomArena;
+};
+
+/* A level as handed out through the interface, along with the state that the
+ * level's threads share and the level's own copies of the strings it was opened
+ * with.*/
+struct dig_level_s
+{
+    struct level_s level;
+    struct level_error_s error;
+    struct level_stats_s stats;
+
+    char *inputFilename;
+    char *roomList;
+};
+
+/* A room face in world space, as it's written into the exported mesh files.*/
+struct export_face_s
+{
+    unsigned numVertices;
+
+    /* An index to the object textures if the face is textured; otherwise, the
+     * negated index of the face's color in the palette.*/
+    int textureIdx;
+
+    int x[4], y[4], z[4];
+    float u[4], v[4];
+
+    /* How dark each vertex is (between 0 = light and 8191 = dark), or 0 if the
+     * mesh has no pre-baked lighting.*/
+    int lighting[4];
+};
+
+/* An open-addressing hash table that gives each distinct key (a fixed number of
+ * 32-bit words) a sequential index in the order in which the keys were first
+ * inserted. Used to weld vertices that faces share.*/
+struct weld_table_s
+{
+    unsigned keyNumWords;
+
+    /* The distinct keys, in insertion order.*/
+    unsigned numKeys;
+    unsigned keysCapacity;
+    uint32_t *keys;
+
+    /* Each slot holds a key's index plus one, or 0 if the slot is empty. The
+     * number of slots is a power of two.*/
+    unsigned numSlots;
+    uint32_t *slots;
+};
+
+#define WELD_TABLE_NOT_FOUND (~0u)
+
+/* A growable block of bytes in memory.*/
+struct byte_buffer_s
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
+/* Writes into a file through a buffer owned by the caller, formatting numbers
+ * without going through printf.*/
+struct output_writer_s
+{
+    const struct level_s *level;
+    char filename[MAX_PATH_LENGTH];
+
+    /* NULL in incremental mode, where the file's contents are instead collected
+     * in memory and only saved if they've changed.*/
+    FILE *file;
+    struct byte_buffer_s contents;
+
+    /* How many bytes have been written into the file so far.*/
+    size_t numBytesWritten;
+
+    /* Set if the file couldn't be opened or written, after which the output is
+     * discarded.*/
+    unsigned failed;
+
+    char *buffer;
+    size_t bufferSize;
+    size_t used;
+};
+
+/* A glTF 2.0 binary (.glb) file being assembled in memory: the JSON arrays of
+ * its scene description, each with its number of elements so far, and the
+ * binary buffer that they refer into.*/
+struct glb_builder_s
+{
+    struct byte_buffer_s nodes, meshes, materials, textures, images, accessors, bufferViews;
+    unsigned numNodes, numMeshes, numMaterials, numTextures, numImages, numAccessors, numBufferViews;
+
+    struct byte_buffer_s bin;
+
+    /* The glTF material of each object texture, the glTF texture of each texture
+     * image, and the material of untextured faces; GLB_NONE until created.*/
+    unsigned *textureMaterials;
+    unsigned *imageTextures;
+    unsigned untexturedMaterial;
+};
+
+#define GLB_NONE (~0u)
+
+/* The number of bytes per vertex in a glTF vertex buffer: float x, y, z; float
+ * u, v; and uint8 r, g, b, a.*/
+#define GLB_VERTEX_SIZE 24
+
+/* A texture archive (.tra) file being written: its layout, planned in advance
+ * so that the pixels can be written an atlas at a time, and how much of it has
+ * been written so far.*/
+struct texture_archive_s
+{
+    struct output_writer_s file;
+    char buffer[OUTPUT_BUFFER_SIZE];
+    size_t numBytesWritten;
+
+    /* The byte offset of each texture atlas's, texture image's and texture
+     * page's pixels in the archive; TEXTURE_ARCHIVE_NONE for those that aren't
+     * in it.*/
+    uint32_t *atlasOffsets;
+    uint32_t *imageOffsets;
+    uint32_t *pageOffsets;
+};
+
+#define TEXTURE_ARCHIVE_NONE (~0u)
+#define TEXTURE_ARCHIVE_HEADER_NUM_WORDS 4
+#define TEXTURE_ARCHIVE_ENTRY_NUM_WORDS 10
+
+/* The pixels of each texture in an archive begin at a multiple of this many
+ * bytes, so that they can be used straight from a memory-mapped archive.*/
+#define TEXTURE_ARCHIVE_ALIGNMENT 64
+
+/* The kinds of texture listed in an archive's directory.*/
+#define TEXTURE_ARCHIVE_ATLAS 0
+#define TEXTURE_ARCHIVE_OBJECT_TEXTURE 1
+#define TEXTURE_ARCHIVE_PAGE 2
+
+/* The flags of an object texture's attributes in an archive's directory.*/
+#define TEXTURE_ARCHIVE_HAS_ALPHA (1 << 0)
+#define TEXTURE_ARCHIVE_IGNORES_DEPTH_TEST (1 << 1)
+#define TEXTURE_ARCHIVE_HAS_WIREFRAME (1 << 2)
+
+/* A file exported on this or a previous run, as listed in a level's manifest.*/
+struct manifest_entry_s
+{
+    char *path; /* Relative to the level's output path.*/
+    uint64_t hash;
+    uint64_t size;
+
+    /* What happened to the file on this run (an OUTPUT_x value).*/
+    unsigned status;
+};
+
+#define OUTPUT_NOT_EXPORTED 0
+#define OUTPUT_UNCHANGED 1
+#define OUTPUT_CHANGED 2
+#define OUTPUT_ADDED 3
+
+/* The content hashes of the files exported into a level's output directory, as
+ * saved in it on the previous run. In incremental mode, only the files whose
+ * contents differ from those listed are written. Safe to update concurrently.*/
+struct output_manifest_s
+{
+    pthread_mutex_t lock;
+
+    unsigned numEntries;
+    unsigned capacity;
+    struct manifest_entry_s *entries;
+
+    /* Maps the hash of an entry's path to the entry's index.*/
+    struct weld_table_s pathHashes;
+};
+
+#define MANIFEST_FILENAME "manifest.txt"
+
+/* Where a room's variable-length sections are in the level file, as found by a
+ * quick first pass over the rooms.*/
+struct room_index_s
+{
+    /* The room's world coordinates.*/
+    int x, z;
+
+    size_t roomDataOffset;
+    unsigned numRoomDataWords;
+    unsigned numVertices;
+    unsigned numQuads;
+    unsigned numTriangles;
+
+    size_t staticObjectsOffset;
+    unsigned numStaticObjects;
+};
+
+struct room_decode_context_s
+{
+    struct level_s *level;
+    const struct room_index_s *roomIndex;
+};
+
+/* A texture page's skyline while images are being packed onto it: the top edge
+ * of the images placed so far, as horizontal segments ordered from left to
+ * right that together span the page's width.*/
+struct skyline_segment_s
+{
+    unsigned x, y;
+    unsigned width;
+};
+
+struct texture_skyline_s
+{
+    unsigned numSegments;
+    unsigned capacity;
+    struct skyline_segment_s *segments;
+
+    /* How far right and down the page's images reach.*/
+    unsigned usedWidth, usedHeight;
+};
+
+/* A texture image waiting to be packed, as sorted into the order of packing.*/
+struct packing_item_s
+{
+    unsigned width, height;
+    unsigned imageIdx;
+};
+
+void arena_init(struct arena_s *const arena)
+{
+    pthread_mutex_init(&arena->lock, NULL);
+    arena->blocks = NULL;
+    arena->numBytesAllocated = 0;
+    arena->numAllocations = 0;
+
+    return;
+}
+
+/* Starts a new block if the current one has less than the given number of bytes
+ * free. Call with the arena locked.*/
+void arena_grow(struct arena_s *const arena, const size_t numBytes)
+{
+    struct arena_block_s *block = arena->blocks;
+
+    if (!block || ((block->size - block->used) < numBytes))
+    {
+        const size_t blockSize = ((numBytes > ARENA_MIN_BLOCK_SIZE)? numBytes : ARENA_MIN_BLOCK_SIZE);
+
+        block = malloc(sizeof(struct arena_block_s));
+        assert(block && "Failed to allocate memory for a level's data.");
+
+        block->data = malloc(blockSize);
+        assert(block->data && "Failed to allocate memory for a level's data.");
+
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    return;
+}
+
+/* Makes sure that the given number of bytes can be allocated without the arena
+ * growing in between. Used to lay out a section's data in one block when the
+ * section's size is known in advance.*/
+void arena_reserve(struct arena_s *const arena, const size_t numBytes)
+{
+    pthread_mutex_lock(&arena->lock);
+    arena_grow(arena, numBytes);
+    pthread_mutex_unlock(&arena->lock);
+
+    return;
+}
+
+void* arena_alloc(struct arena_s *const arena, const size_t numBytes)
+{
+    const size_t alignedSize = ARENA_ALIGNED_SIZE(numBytes? numBytes : 1);
+    void *memory = NULL;
+
+    pthread_mutex_lock(&arena->lock);
+    arena_grow(arena, alignedSize);
+    memory = (arena->blocks->data + arena->blocks->used);
+    arena->blocks->used += alignedSize;
+    arena->numBytesAllocated += alignedSize;
+    arena->numAllocations++;
+    pthread_mutex_unlock(&arena->lock);
+
+    return memory;
+}
+
+/* Frees all memory allocated from the arena.*/
+void arena_release(struct arena_s *const arena)
+{
+    while (arena->blocks)
+    {
+        struct arena_block_s *const next = arena->blocks->next;
+
+        free(arena->blocks->data);
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+
+    pthread_mutex_destroy(&arena->lock);
+
+    return;
+}
+
+/* Returns the current time in seconds from an arbitrary starting point.*/
+double wall_clock_seconds(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec + (now.tv_nsec / 1e9));
+}
+
+/* When collecting statistics, starts timing a phase of the level's extraction
+ * by the given name. Call from the level's main thread.*/
+void stats_begin_phase(const struct level_s *const level, const char *const name)
+{
+    struct level_stats_s *const stats = level->stats;
+
+    if (!stats)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&stats->lock);
+    stats->phaseStart.numBytesWritten = stats->numBytesWritten;
+    stats->phaseStart.numFilesWritten = stats->numFilesWritten;
+    stats->phaseStart.numFaces = stats->numFaces;
+    pthread_mutex_unlock(&stats->lock);
+
+    stats->phaseStart.name = name;
+    stats->phaseStart.numBytesAllocated = level->arena.numBytesAllocated;
+    stats->phaseStart.numAllocations = level->arena.numAllocations;
+    stats->phaseStartTime = wall_clock_seconds();
+
+    return;
+}
+
+/* When collecting statistics, records the phase begun last, during which the
+ * given number of bytes were read from the level file. Phases past the first
+ * DIG_MAX_STATS_PHASES aren't recorded.*/
+void stats_end_phase(const struct level_s *const level, const uint64_t numBytesRead)
+{
+    struct level_stats_s *const stats = level->stats;
+    struct dig_phase_stats_s *phase = NULL;
+
+    if (!stats ||
+        (stats->report.numPhases >= DIG_MAX_STATS_PHASES))
+    {
+        return;
+    }
+
+    phase = &stats->report.phases[stats->report.numPhases++];
+    phase->name = stats->phaseStart.name;
+    phase->seconds = (wall_clock_seconds() - stats->phaseStartTime);
+    phase->numBytesRead = numBytesRead;
+    phase->numBytesAllocated = (level->arena.numBytesAllocated - stats->phaseStart.numBytesAllocated);
+    phase->numAllocations = (level->arena.numAllocations - stats->phaseStart.numAllocations);
+
+    pthread_mutex_lock(&stats->lock);
+    phase->numBytesWritten = (stats->numBytesWritten - stats->phaseStart.numBytesWritten);
+    phase->numFilesWritten = (stats->numFilesWritten - stats->phaseStart.numFilesWritten);
+    phase->numFaces = (stats->numFaces - stats->phaseStart.numFaces);
+    pthread_mutex_unlock(&stats->lock);
+
+    return;
+}
+
+/* When collecting statistics, counts an output file of the given size as having
+ * been written. Can be called from any of the level's threads.*/
+void stats_count_output_file(const struct level_s *const level, const uint64_t numBytes)
+{
+    struct level_stats_s *const stats = level->stats;
+
+    if (!stats)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&stats->lock);
+    stats->numBytesWritten += numBytes;
+    stats->numFilesWritten++;
+    pthread_mutex_unlock(&stats->lock);
+
+    return;
+}
+
+/* When collecting statistics, counts the given number of faces as having been
+ * processed in the current phase. Can be called from any of the level's threads.*/
+void stats_count_faces(const struct level_s *const level, const uint64_t numFaces)
+{
+    struct level_stats_s *const stats = level->stats;
+
+    if (!stats)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&stats->lock);
+    stats->numFaces += numFaces;
+    pthread_mutex_unlock(&stats->lock);
+
+    return;
+}
+
+unsigned mesh_num_faces(const struct tr_mesh_s *const mesh)
+{
+    return (mesh->numTexturedQuads +
+            mesh->numTexturedTriangles +
+            mesh->numUntexturedQuads +
+            mesh->numUntexturedTriangles);
+}
+
+/* Returns the number of arena bytes that a vertex buffer of the given size takes
+ * up.*/
+size_t vertex_buffer_arena_size(const unsigned numVertices, const unsigned hasLighting)
+{
+    return ((3 * ARENA_ALIGNED_SIZE(sizeof(int32_t) * numVertices)) +
+            (hasLighting? ARENA_ALIGNED_SIZE(sizeof(int16_t) * numVertices) : 0));
+}
+
+void alloc_vertex_buffer(struct arena_s *const arena,
+                         struct tr_vertex_buffer_s *const vertices,
+                         const unsigned numVertices,
+                         const unsigned hasLighting)
+{
+    vertices->numVertices = numVertices;
+    vertices->x = arena_alloc(arena, (sizeof(int32_t) * numVertices));
+    vertices->y = arena_alloc(arena, (sizeof(int32_t) * numVertices));
+    vertices->z = arena_alloc(arena, (sizeof(int32_t) * numVertices));
+    vertices->lighting = (hasLighting? arena_alloc(arena, (sizeof(int16_t) * numVertices)) : NULL);
+
+    return;
+}
+
+/* Maps the given open file into memory in its entirety. Returns DIG_OK, or
+ * DIG_ERROR_INPUT if the file couldn't be mapped.*/
+int map_input_fd(struct data_cursor_s *const inputFile, const int fd)
+{
+    struct stat fileInfo;
+    void *mapping = MAP_FAILED;
+
+    if ((fstat(fd, &fileInfo) == 0) && (fileInfo.st_size > 0))
+    {
+        mapping = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    if (mapping == MAP_FAILED)
+    {
+        return DIG_ERROR_INPUT;
+    }
+
+    /* The level is parsed front to back, so let the kernel read ahead.*/
+    madvise(mapping, fileInfo.st_size, MADV_SEQUENTIAL);
+
+    inputFile->data = mapping;
+    inputFile->size = fileInfo.st_size;
+    inputFile->pos = 0;
+    inputFile->failed = 0;
+
+    return DIG_OK;
+}
+
+/* Maps the given file into memory in its entirety; see map_input_fd().*/
+int map_input_file(struct data_cursor_s *const inputFile, const char *const filename)
+{
+    const int fd = open(filename, O_RDONLY);
+    int result = DIG_ERROR_INPUT;
+
+    if (fd >= 0)
+    {
+        result = map_input_fd(inputFile, fd);
+        close(fd);
+    }
+
+    return result;
+}
+
+/* Reads the given file descriptor (e.g. a pipe) to its end into an unlinked
+ * temporary file, and maps that into memory in its entirety. The data thus take
+ * up page cache rather than memory of their own. Returns DIG_OK, or
+ * DIG_ERROR_INPUT if the data couldn't be read or stored.*/
+int spill_input_fd(struct data_cursor_s *const inputFile, const int fd)
+{
+    const char *const tempDirectory = getenv("TMPDIR");
+    const size_t bufferSize = (64 * 1024);
+    uint8_t *const buffer = malloc(bufferSize);
+    char filename[MAX_PATH_LENGTH];
+    int result = DIG_OK;
+    int tempFd = -1;
+
+    assert(buffer && "Failed to allocate memory for reading the level file.");
+
+    snprintf(filename, sizeof(filename), "%s/dig-XXXXXX", ((tempDirectory && *tempDirectory)? tempDirectory : "/tmp"));
+
+    if ((tempFd = mkstemp(filename)) < 0)
+    {
+        free(buffer);
+        return DIG_ERROR_INPUT;
+    }
+
+    unlink(filename);
+
+    while (result == DIG_OK)
+    {
+        const ssize_t numRead = read(fd, buffer, bufferSize);
+        ssize_t numWritten = 0;
+
+        if (numRead == 0)
+        {
+            break;
+        }
+        else if (numRead < 0)
+        {
+            if (errno != EINTR) result = DIG_ERROR_INPUT;
+            continue;
+        }
+
+        while ((numWritten < numRead) && (result == DIG_OK))
+        {
+            const ssize_t n = write(tempFd, (buffer + numWritten), (numRead - numWritten));
+
+            if (n > 0) numWritten += n;
+            else if ((n < 0) && (errno != EINTR)) result = DIG_ERROR_INPUT;
+        }
+    }
+
+    if (result == DIG_OK)
+    {
+        result = map_input_fd(inputFile, tempFd);
+    }
+
+    close(tempFd);
+    free(buffer);
+
+    return result;
+}
+
+void unmap_input_file(struct data_cursor_s *const inputFile)
+{
+    munmap((void*)inputFile->data, inputFile->size);
+
+    inputFile->data = NULL;
+    inputFile->size = 0;
+    inputFile->pos = 0;
+
+    return;
+}
+
+/* Lets the kernel drop the pages of the given range of the memory-mapped level
+ * file from memory, once they're no longer needed. They're read back in from the
+ * file if they're accessed again. Does nothing if the level file wasn't mapped
+ * by the level itself.*/
+void release_input_range(const struct level_s *const level, const size_t offset, const size_t numBytes)
+{
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t firstPage = (((offset + pageSize - 1) / pageSize) * pageSize);
+    const size_t endPage = (((offset + numBytes) / pageSize) * pageSize);
+
+    if (!level->isMapped ||
+        ((offset + numBytes) > level->inputFile.size) ||
+        (endPage <= firstPage))
+    {
+        return;
+    }
+
+    madvise((void*)(level->inputFile.data + firstPage), (endPage - firstPage), MADV_DONTNEED);
+
+    return;
+}
+
+/* In streaming mode, lets the kernel drop the pages of the level file behind
+ * the given position, which is read through front to back, every so often. The
+ * position up to which pages were last dropped is kept in releasedEnd, which
+ * starts out at 0.*/
+void release_input_behind(const struct level_s *const level, size_t *const releasedEnd, const size_t pos)
+{
+    size_t start = 0;
+
+    if (!level->streaming ||
+        (pos < (*releasedEnd + STREAM_RELEASE_INTERVAL)))
+    {
+        return;
+    }
+
+    start = ((*releasedEnd > STREAM_RELEASE_OVERLAP)? (*releasedEnd - STREAM_RELEASE_OVERLAP) : 0);
+    release_input_range(level, start, (pos - start));
+    *releasedEnd = pos;
+
+    return;
+}
+
+/* Records the given error (a DIG_ERROR_x value) as the level's, unless it has
+ * already had one. Can be called from any of the level's threads.*/
+void set_level_error(const struct level_s *const level, const int code)
+{
+    struct level_error_s *const error = level->error;
+
+    pthread_mutex_lock(&error->lock);
+    if (error->code == DIG_OK)
+    {
+        error->code = code;
+    }
+    pthread_mutex_unlock(&error->lock);
+
+    return;
+}
+
+/* Returns the first error that has occurred with the level, or DIG_OK.*/
+int level_error(const struct level_s *const level)
+{
+    struct level_error_s *const error = level->error;
+    int code = DIG_OK;
+
+    pthread_mutex_lock(&error->lock);
+    code = error->code;
+    pthread_mutex_unlock(&error->lock);
+
+    return code;
+}
+
+/* Records the level file as malformed if the given cursor into it has failed.*/
+void check_cursor(const struct level_s *const level, const struct data_cursor_s *const cursor)
+{
+    if (cursor->failed)
+    {
+        set_level_error(level, DIG_ERROR_MALFORMED);
+    }
+
+    return;
+}
+
+/* Returns the next little-endian value of the given byte size, zero-extended.*/
+int32_t read_value(struct data_cursor_s *const cursor, const unsigned numBytes)
+{
+    uint32_t value = 0;
+    unsigned i = 0;
+
+    assert((numBytes > 0) && "Can't read a 0-byte value.");
+    assert((numBytes <= sizeof(value)) && "Asked to read a value larger than the input buffer.");
+
+    if (numBytes > (cursor->size - cursor->pos))
+    {
+        cursor->failed = 1;
+        cursor->pos = cursor->size;
+
+        return 0;
+    }
+
+    for (i = 0; i < numBytes; i++)
+    {
+        value |= ((uint32_t)cursor->data[cursor->pos + i] << (i * 8));
+    }
+
+    cursor->pos += numBytes;
+
+    return (int32_t)value;
+}
+
+int16_t read_int16(struct data_cursor_s *const cursor)
+{
+    return (int16_t)read_value(cursor, 2);
+}
+
+/* Returns a pointer to the next given number of bytes in the data, without
+ * copying them; or NULL if there aren't that many bytes left.*/
+const uint8_t* read_bytes(struct data_cursor_s *const cursor, const size_t numBytes)
+{
+    const uint8_t *const bytes = (cursor->data + cursor->pos);
+
+    if (numBytes > (cursor->size - cursor->pos))
+    {
+        cursor->failed = 1;
+        cursor->pos = cursor->size;
+
+        return NULL;
+    }
+
+    cursor->pos += numBytes;
+
+    return bytes;
+}
+
+/* Returns a cursor limited to the next given number of bytes in the data. If
+ * there aren't that many bytes left, the cursor is empty and failed.*/
+struct data_cursor_s read_section(struct data_cursor_s *const cursor, const size_t numBytes)
+{
+    struct data_cursor_s section;
+
+    section.data = read_bytes(cursor, numBytes);
+    section.size = (section.data? numBytes : 0);
+    section.pos = 0;
+    section.failed = !section.data;
+
+    return section;
+}
+
+void skip_num_bytes(struct data_cursor_s *const cursor, const size_t numBytes)
+{
+    if (numBytes > (cursor->size - cursor->pos))
+    {
+        cursor->failed = 1;
+        cursor->pos = cursor->size;
+
+        return;
+    }
+
+    cursor->pos += numBytes;
+
+    return;
+}
+
+void seek_to(struct data_cursor_s *const cursor, const size_t pos)
+{
+    if (pos > cursor->size)
+    {
+        cursor->failed = 1;
+        cursor->pos = cursor->size;
+
+        return;
+    }
+
+    cursor->pos = pos;
+
+    return;
+}
+
+/* Writes into the given MAX_PATH_LENGTH-sized buffer the path of an output file,
+ * formatted relative to the level's output directory.*/
+void make_output_filename(char *const dst, const struct level_s *const level, const char *const format, ...)
+{
+    va_list args;
+    size_t length = strlen(level->outputPath);
+
+    assert((length < MAX_PATH_LENGTH) && "Output path is too long.");
+    memcpy(dst, level->outputPath, length);
+
+    va_start(args, format);
+    length += vsnprintf((dst + length), (MAX_PATH_LENGTH - length), format, args);
+    va_end(args);
+
+    assert((length < MAX_PATH_LENGTH) && "Output path is too long.");
+
+    return;
+}
+
+/* Returns the next value as an index to a vertex list of the given length; or 0,
+ * failing the cursor, if it's out of range.*/
+unsigned read_vertex_idx(struct data_cursor_s *const cursor, const unsigned numVertices)
+{
+    const unsigned vertexIdx = (uint16_t)read_value(cursor, 2);
+
+    if (vertexIdx >= numVertices)
+    {
+        cursor->failed = 1;
+
+        return 0;
+    }
+
+    return vertexIdx;
+}
+
+/* Returns the next value as the number of elements of the given byte size that
+ * follow it; or 0, failing the cursor, if the cursor has already failed or there
+ * aren't that many bytes left.*/
+unsigned read_element_count(struct data_cursor_s *const cursor, const size_t elementSize)
+{
+    const unsigned count = (uint16_t)read_value(cursor, 2);
+
+    if (cursor->failed ||
+        ((count * elementSize) > (cursor->size - cursor->pos)))
+    {
+        cursor->failed = 1;
+
+        return 0;
+    }
+
+    return count;
+}
+
+/* In verbose mode, prints out the given message about the section being read,
+ * prefixed by its position in the level file (the current read position plus
+ * the given offset).*/
+void log_section(const struct level_s *const level, const int posOffset, const char *const format, ...)
+{
+    va_list args;
+
+    if (!level->verbose)
+    {
+        return;
+    }
+
+    printf("%ld", ((long)level->inputFile.pos + posOffset));
+
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+
+    return;
+}
+
+/* Parses a list of indices and inclusive index ranges, such as "3,17-20", setting
+ * the flag in isSelected of each listed index below numItems. isSelected can be
+ * NULL to just validate the list. Returns -1 if the list is malformed, 1 if it
+ * names indices of numItems or higher (which are ignored), and 0 otherwise.*/
+int parse_index_list(const char *const list, uint8_t *const isSelected, const unsigned numItems)
+{
+    const char *c = list;
+    int result = 0;
+
+    do
+    {
+        unsigned long first = 0, last = 0, idx = 0;
+        char *end = NULL;
+
+        if ((*c < '0') || (*c > '9'))
+        {
+            return -1;
+        }
+
+        first = last = strtoul(c, &end, 10);
+        c = end;
+
+        if (*c == '-')
+        {
+            c++;
+
+            if ((*c < '0') || (*c > '9'))
+            {
+                return -1;
+            }
+
+            last = strtoul(c, &end, 10);
+            c = end;
+
+            if (last < first)
+            {
+                return -1;
+            }
+        }
+
+        if (*c && (*c != ','))
+        {
+            return -1;
+        }
+
+        if (last >= numItems)
+        {
+            result = 1;
+        }
+
+        for (idx = first; (idx <= last) && (idx < numItems); idx++)
+        {
+            isSelected[idx] = 1;
+        }
+    } while (*c++ == ',');
+
+    return result;
+}
+
+/* A range of task indices owned by one worker thread of a task pool. The owner
+ * takes tasks from the front of the range, and idle workers steal from its back.*/
+struct task_queue_s
+{
+    pthread_mutex_t lock;
+    unsigned front, back;
+};
+
+struct task_pool_s
+{
+    unsigned numWorkers;
+    struct task_queue_s *queues;
+
+    void (*taskFn)(void *context, const unsigned taskIdx);
+    void *context;
+};
+
+struct task_worker_s
+{
+    struct task_pool_s *pool;
+    unsigned idx;
+};
+
+/* Takes the next task from the given worker's own queue. Returns 0 if the queue
+ * is empty.*/
+int take_task(struct task_queue_s *const queue, unsigned *const taskIdx)
+{
+    int gotTask = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->front < queue->back)
+    {
+        *taskIdx = queue->front++;
+        gotTask = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return gotTask;
+}
+
+/* Moves half of the remaining tasks of some other worker into the given worker's
+ * queue. Returns 0 if there was nothing left to steal.*/
+int steal_tasks(struct task_pool_s *const pool, const unsigned thiefIdx)
+{
+    unsigned i = 0;
+
+    for (i = 1; i < pool->numWorkers; i++)
+    {
+        struct task_queue_s *const victim = &pool->queues[(thiefIdx + i) % pool->numWorkers];
+        unsigned stolenFront = 0, stolenBack = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->front < victim->back)
+        {
+            stolenBack = victim->back;
+            stolenFront = (victim->back - ((victim->back - victim->front + 1) / 2));
+            victim->back = stolenFront;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (stolenFront < stolenBack)
+        {
+            struct task_queue_s *const thief = &pool->queues[thiefIdx];
+
+            pthread_mutex_lock(&thief->lock);
+            thief->front = stolenFront;
+            thief->back = stolenBack;
+            pthread_mutex_unlock(&thief->lock);
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void* task_worker_thread(void *const arg)
+{
+    const struct task_worker_s *const worker = arg;
+    struct task_pool_s *const pool = worker->pool;
+
+    do
+    {
+        unsigned taskIdx = 0;
+
+        while (take_task(&pool->queues[worker->idx], &taskIdx))
+        {
+            pool->taskFn(pool->context, taskIdx);
+        }
+    } while (steal_tasks(pool, worker->idx));
+
+    return NULL;
+}
+
+/* Calls the given function once for each task index in [0, numTasks), spreading
+ * the calls over the given number of threads. Returns once all tasks are done.*/
+void run_parallel_tasks(const unsigned numTasks,
+                        void (*const taskFn)(void *context, const unsigned taskIdx),
+                        void *const context,
+                        unsigned numThreads)
+{
+    struct task_pool_s pool;
+    struct task_worker_s *workers = NULL;
+    pthread_t *threads = NULL;
+    unsigned numStarted = 1;
+    unsigned i = 0;
+
+    if (numThreads > numTasks) numThreads = numTasks;
+    if (numThreads < 1) numThreads = 1;
+
+    if (numThreads == 1)
+    {
+        for (i = 0; i < numTasks; i++)
+        {
+            taskFn(context, i);
+        }
+
+        return;
+    }
+
+    pool.numWorkers = numThreads;
+    pool.taskFn = taskFn;
+    pool.context = context;
+    pool.queues = malloc(sizeof(struct task_queue_s) * numThreads);
+    workers = malloc(sizeof(struct task_worker_s) * numThreads);
+    threads = malloc(sizeof(pthread_t) * numThreads);
+    assert((pool.queues && workers && threads) && "Failed to allocate memory for a task pool.");
+
+    /* Give each worker an equal share of the tasks to start with.*/
+    for (i = 0; i < numThreads; i++)
+    {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].front = ((numTasks * (uint64_t)i) / numThreads);
+        pool.queues[i].back = ((numTasks * (uint64_t)(i + 1)) / numThreads);
+
+        workers[i].pool = &pool;
+        workers[i].idx = i;
+    }
+
+    /* If a thread can't be started, the workers that are running will steal its
+     * share of the tasks.*/
+    for (numStarted = 1; numStarted < numThreads; numStarted++)
+    {
+        if (pthread_create(&threads[numStarted], NULL, task_worker_thread, &workers[numStarted]) != 0)
+        {
+            break;
+        }
+    }
+
+    /* The calling thread acts as the first worker.*/
+    task_worker_thread(&workers[0]);
+
+    for (i = 1; i < numStarted; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i < numThreads; i++)
+    {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+
+    free(pool.queues);
+    free(workers);
+    free(threads);
+
+    return;
+}
+
+unsigned num_cpu_cores(void)
+{
+    const long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return ((numCores > 0)? numCores : 1);
+}
+
+uint32_t hash_words(const uint32_t *const words, const unsigned numWords)
+{
+    uint32_t hash = 2166136261u;
+    unsigned i = 0;
+
+    for (i = 0; i < numWords; i++)
+    {
+        hash = ((hash ^ words[i]) * 16777619u);
+    }
+
+    /* Mix the bits so that the low ones, which pick the slot, depend on all of them.*/
+    hash ^= (hash >> 16);
+    hash *= 0x85ebca6bu;
+    hash ^= (hash >> 13);
+    hash *= 0xc2b2ae35u;
+    hash ^= (hash >> 16);
+
+    return hash;
+}
+
+/* Returns a 64-bit hash of the given bytes, taken eight at a time. Used to tell
+ * whether a file's contents have changed.*/
+uint64_t hash_bytes(const uint8_t *const data, const size_t numBytes)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+
+    for (i = 0; (i + 8) <= numBytes; i += 8)
+    {
+        uint64_t word = 0;
+
+        memcpy(&word, (data + i), sizeof(word));
+        hash = ((hash ^ word) * 0x100000001b3ULL);
+        hash ^= (hash >> 32);
+    }
+
+    for (; i < numBytes; i++)
+    {
+        hash = ((hash ^ data[i]) * 0x100000001b3ULL);
+    }
+
+    return hash;
+}
+
+void weld_table_init(struct weld_table_s *const table, const unsigned keyNumWords, const unsigned expectedNumKeys)
+{
+    table->keyNumWords = keyNumWords;
+    table->numKeys = 0;
+    table->keysCapacity = (expectedNumKeys? expectedNumKeys : 1);
+    table->keys = malloc(sizeof(uint32_t) * keyNumWords * table->keysCapacity);
+
+    /* Keep the load factor at or below 1/2.*/
+    table->numSlots = 16;
+    while (table->numSlots < (expectedNumKeys * 2))
+    {
+        table->numSlots *= 2;
+    }
+
+    table->slots = calloc(table->numSlots, sizeof(uint32_t));
+
+    assert((table->keys && table->slots) && "Failed to allocate memory for a hash table.");
+
+    return;
+}
+
+void weld_table_free(struct weld_table_s *const table)
+{
+    free(table->keys);
+    free(table->slots);
+
+    table->keys = NULL;
+    table->slots = NULL;
+    table->numKeys = 0;
+
+    return;
+}
+
+/* Returns the index of the given key in the table, or WELD_TABLE_NOT_FOUND if
+ * the key isn't in the table.*/
+unsigned weld_table_find(const struct weld_table_s *const table, const uint32_t *const key)
+{
+    const size_t keySize = (sizeof(uint32_t) * table->keyNumWords);
+    unsigned slotIdx = (hash_words(key, table->keyNumWords) & (table->numSlots - 1));
+
+    while (table->slots[slotIdx])
+    {
+        const unsigned keyIdx = (table->slots[slotIdx] - 1);
+
+        if (memcmp(&table->keys[keyIdx * table->keyNumWords], key, keySize) == 0)
+        {
+            return keyIdx;
+        }
+
+        slotIdx = ((slotIdx + 1) & (table->numSlots - 1));
+    }
+
+    return WELD_TABLE_NOT_FOUND;
+}
+
+/* Returns the index of the given key in the table, inserting the key first if
+ * it isn't in the table yet.*/
+unsigned weld_table_insert(struct weld_table_s *const table, const uint32_t *const key)
+{
+    const size_t keySize = (sizeof(uint32_t) * table->keyNumWords);
+    unsigned slotIdx = (hash_words(key, table->keyNumWords) & (table->numSlots - 1));
+
+    while (table->slots[slotIdx])
+    {
+        const unsigned keyIdx = (table->slots[slotIdx] - 1);
+
+        if (memcmp(&table->keys[keyIdx * table->keyNumWords], key, keySize) == 0)
+        {
+            return keyIdx;
+        }
+
+        slotIdx = ((slotIdx + 1) & (table->numSlots - 1));
+    }
+
+    if (table->numKeys == table->keysCapacity)
+    {
+        table->keysCapacity *= 2;
+        table->keys = realloc(table->keys, (keySize * table->keysCapacity));
+
+        assert(table->keys && "Failed to allocate memory for a hash table.");
+    }
+
+    memcpy(&table->keys[table->numKeys * table->keyNumWords], key, keySize);
+    table->slots[slotIdx] = ++table->numKeys;
+
+    /* Grow the table before it gets too full for linear probing to stay fast.*/
+    if ((table->numKeys * 2) > table->numSlots)
+    {
+        unsigned i = 0;
+
+        free(table->slots);
+        table->numSlots *= 2;
+        table->slots = calloc(table->numSlots, sizeof(uint32_t));
+
+        assert(table->slots && "Failed to allocate memory for a hash table.");
+
+        for (i = 0; i < table->numKeys; i++)
+        {
+            slotIdx = (hash_words(&table->keys[i * table->keyNumWords], table->keyNumWords) & (table->numSlots - 1));
+
+            while (table->slots[slotIdx])
+            {
+                slotIdx = ((slotIdx + 1) & (table->numSlots - 1));
+            }
+
+            table->slots[slotIdx] = (i + 1);
+        }
+    }
+
+    return (table->numKeys - 1);
+}
+
+/* The horizontal rotation of a static object by the number of 90-degree turns it
+ * makes, as a matrix that maps (x, z) to ((m[0] * x) + (m[1] * z), (m[2] * x) +
+ * (m[3] * z)).*/
+static const int32_t STATIC_OBJECT_ROTATIONS[4][4] = {{ 1,  0,  0,  1},
+                                                      { 0,  1, -1,  0},
+                                                      {-1,  0,  0, -1},
+                                                      { 0, -1,  1,  0}};
+
+/* Rotates and moves the given mesh vertices into the given static object's place
+ * in the world, storing them as the object's vertices. Works over the vertex
+ * arrays in batches.
+ *
+ * Each row of a rotation matrix has a single nonzero entry of 1 or -1, so each
+ * rotated coordinate is one of the original x and z, possibly negated.*/
+void place_static_object(struct arena_s *const arena,
+                         struct tr_mesh_meta_s *const object,
+                         const struct tr_vertex_buffer_s *const meshVertices)
+{
+    const int32_t *const m = STATIC_OBJECT_ROTATIONS[object->rotation & 3];
+    const int32_t *const srcX = (m[0]? meshVertices->x : meshVertices->z);
+    const int32_t *const srcY = meshVertices->y;
+    const int32_t *const srcZ = (m[2]? meshVertices->x : meshVertices->z);
+    const int32_t signX = (((m[0] + m[1]) < 0)? -1 : 0); /* Negates a value v as ((v ^ sign) - sign).*/
+    const int32_t signZ = (((m[2] + m[3]) < 0)? -1 : 0);
+    const int32_t offsetX = object->x, offsetY = object->y, offsetZ = object->z;
+    const unsigned numVertices = meshVertices->numVertices;
+    int32_t *dstX = NULL, *dstY = NULL, *dstZ = NULL;
+    unsigned i = 0;
+
+    alloc_vertex_buffer(arena, &object->vertices, numVertices, 0);
+    dstX = object->vertices.x;
+    dstY = object->vertices.y;
+    dstZ = object->vertices.z;
+
+    #ifdef __SSE2__
+    {
+        const __m128i signX4 = _mm_set1_epi32(signX), signZ4 = _mm_set1_epi32(signZ);
+        const __m128i offsetX4 = _mm_set1_epi32(offsetX), offsetY4 = _mm_set1_epi32(offsetY), offsetZ4 = _mm_set1_epi32(offsetZ);
+
+        for (; (i + 4) <= numVertices; i += 4)
+        {
+            const __m128i x = _mm_loadu_si128((const __m128i*)&srcX[i]);
+            const __m128i y = _mm_loadu_si128((const __m128i*)&srcY[i]);
+            const __m128i z = _mm_loadu_si128((const __m128i*)&srcZ[i]);
+
+            _mm_storeu_si128((__m128i*)&dstX[i], _mm_add_epi32(_mm_sub_epi32(_mm_xor_si128(x, signX4), signX4), offsetX4));
+            _mm_storeu_si128((__m128i*)&dstY[i], _mm_add_epi32(y, offsetY4));
+            _mm_storeu_si128((__m128i*)&dstZ[i], _mm_add_epi32(_mm_sub_epi32(_mm_xor_si128(z, signZ4), signZ4), offsetZ4));
+        }
+    }
+    #endif
+
+    for (; i < numVertices; i++)
+    {
+        dstX[i] = (((srcX[i] ^ signX) - signX) + offsetX);
+        dstY[i] = (srcY[i] + offsetY);
+        dstZ[i] = (((srcZ[i] ^ signZ) - signZ) + offsetZ);
+    }
+
+    return;
+}
+
+/* Returns true if the static objects' vertices need to be moved into place in
+ * the world: when they're baked into the exported rooms' meshes.*/
+int static_objects_need_placing(const struct level_s *const level)
+{
+    return ((level->exportParts & EXPORT_ROOM_MESHES) &&
+            (level->meshFormats & (MESH_FORMAT_TRM | MESH_FORMAT_TRB | MESH_FORMAT_OBJ)) &&
+            !level->instancedStatics);
+}
+
+void place_static_objects_task(void *const context, const unsigned taskIdx)
+{
+    struct level_s *const level = context;
+    struct tr_room_mesh_s *const room = &level->importedData.roomMeshes[taskIdx];
+    unsigned numFaces = 0;
+    unsigned i = 0;
+
+    if (!level->importedData.roomIsSelected[taskIdx])
+    {
+        return;
+    }
+
+    for (i = 0; i < room->numStaticObjects; i++)
+    {
+        struct tr_mesh_meta_s *const object = &room->staticObjects[i];
+
+        place_static_object(level->roomArena, object, &level->importedData.meshes[object->meshIdx].vertices);
+        numFaces += mesh_num_faces(&level->importedData.meshes[object->meshIdx]);
+    }
+
+    stats_count_faces(level, numFaces);
+
+    return;
+}
+
+/* Records where the next room's variable-length sections are in the level file,
+ * and skips past the room.*/
+void index_room(struct level_s *const level, const unsigned roomIdx, struct room_index_s *const index)
+{
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    unsigned numPortals = 0;
+    unsigned numZSectors = 0;
+    unsigned numXSectors = 0;
+    int ambientIntensity = 0;
+    unsigned numLights = 0;
+    unsigned alternateRoom = 0;
+    int16_t flags = 0;
+
+    log_section(level, 0, "   #%d\n", roomIdx);
+
+    /* Room info.*/
+    index->x = read_value(inputFile, 4);
+    index->z = read_value(inputFile, 4);
+    skip_num_bytes(inputFile, 4); /* Skip 'yBottom'.*/
+    skip_num_bytes(inputFile, 4); /* Skip 'yTop'.   */
+
+    /* Room data.*/
+    {
+        struct data_cursor_s roomData;
+
+        index->numRoomDataWords = read_value(inputFile, 4);
+        log_section(level, -2, "     Room data size: %d\n", index->numRoomDataWords);
+
+        index->roomDataOffset = inputFile->pos;
+        roomData = read_section(inputFile, (index->numRoomDataWords * 2));
+
+        /* Peek at the geometry counts, so that memory for the rooms can be
+         * reserved in one go.*/
+        index->numVertices = (uint16_t)read_int16(&roomData);
+        log_section(level, 0, "       Vertices: %d\n", index->numVertices);
+        skip_num_bytes(&roomData, (index->numVertices * SIZE_TR_ROOM_VERTEX));
+
+        index->numQuads = (uint16_t)read_int16(&roomData);
+        log_section(level, 0, "       Quads: %d\n", index->numQuads);
+        skip_num_bytes(&roomData, (index->numQuads * SIZE_TR_ROOM_QUAD));
+
+        index->numTriangles = (uint16_t)read_int16(&roomData);
+        log_section(level, 0, "       Triangles: %d\n", index->numTriangles);
+        skip_num_bytes(&roomData, (index->numTriangles * SIZE_TR_ROOM_TRIANGLE));
+
+        check_cursor(level, &roomData);
+    }
+
+    /* Portals.*/
+    numPortals = read_value(inputFile, 2);
+    log_section(level, -2, "     Portals: %d\n", numPortals);
+    skip_num_bytes(inputFile, SIZE_TR_ROOM_PORTAL * numPortals);
+
+    /* Sectors.*/
+    numZSectors = read_value(inputFile, 2);
+    numXSectors = read_value(inputFile, 2);
+    log_section(level, -4, "     Sectors: %d, %d\n", numZSectors, numXSectors);
+    skip_num_bytes(inputFile, SIZE_TR_ROOM_SECTOR * numZSectors * numXSectors);
+
+    /* Lights.*/
+    ambientIntensity = (int16_t)read_value(inputFile, 2);
+    numLights = read_value(inputFile, 2);
+    log_section(level, -4, "     Lights: %d (%d)\n", numLights, ambientIntensity);
+    skip_num_bytes(inputFile, SIZE_TR_ROOM_LIGHT * numLights);
+
+    /* Static room meshes.*/
+    index->numStaticObjects = read_value(inputFile, 2);
+    log_section(level, -2, "     Static meshes: %d\n", index->numStaticObjects);
+    index->staticObjectsOffset = inputFile->pos;
+    skip_num_bytes(inputFile, SIZE_TR_ROOM_STATIC_MESH * index->numStaticObjects);
+
+    /* Miscellaneous.*/
+    alternateRoom = read_value(inputFile, 2);
+    flags = read_value(inputFile, 2);
+    log_section(level, -2, "     Alternate room: %d\n", alternateRoom);
+    log_section(level, -2, "     Flags: 0x%x\n", flags);
+
+    return;
+}
+
+/* Decodes the geometry and static objects of an indexed room. Rooms don't depend
+ * on each other, so any number of them can be decoded concurrently.*/
+void decode_room(struct level_s *const level, const unsigned roomIdx, const struct room_index_s *const index)
+{
+    struct tr_room_mesh_s *const room = &level->importedData.roomMeshes[roomIdx];
+    struct data_cursor_s roomData = level->inputFile;
+    struct data_cursor_s staticObjectData = level->inputFile;
+    unsigned p = 0;
+
+    room->x = index->x;
+    room->z = index->z;
+    room->numStaticObjects = index->numStaticObjects;
+
+    seek_to(&roomData, index->roomDataOffset);
+    roomData = read_section(&roomData, (index->numRoomDataWords * 2));
+
+    /* Parse the raw room mesh data.*/
+    {
+        struct tr_vertex_buffer_s *const vertices = &room->vertices;
+
+        /* Vertex list.*/
+        {
+            alloc_vertex_buffer(level->roomArena, vertices, read_element_count(&roomData, SIZE_TR_ROOM_VERTEX), 1);
+
+            for (p = 0; p < vertices->numVertices; p++)
+            {
+                vertices->x[p] = (read_int16(&roomData) + room->x);
+                vertices->y[p] = read_int16(&roomData);
+                vertices->z[p] = (read_int16(&roomData) + room->z);
+                vertices->lighting[p] = read_int16(&roomData);
+            }
+        }
+
+        /* Quads.*/
+        {
+            room->numQuads = read_element_count(&roomData, SIZE_TR_ROOM_QUAD);
+            room->quads = arena_alloc(level->roomArena, (sizeof(struct tr_quad_s) * room->numQuads));
+
+            for (p = 0; p < room->numQuads; p++)
+            {
+                int16_t textureIdx = 0;
+
+                room->quads[p].vertexIdx[0] = read_vertex_idx(&roomData, vertices->numVertices);
+                room->quads[p].vertexIdx[1] = read_vertex_idx(&roomData, vertices->numVertices);
+                room->quads[p].vertexIdx[2] = read_vertex_idx(&roomData, vertices->numVertices);
+                room->quads[p].vertexIdx[3] = read_vertex_idx(&roomData, vertices->numVertices);
+                textureIdx = read_int16(&roomData);
+
+                room->quads[p].isDoubleSided = (textureIdx & 0x8000);
+                room->quads[p].textureIdx = (textureIdx & 0x7fff);
+            }
+        }
+
+        /* Triangles.*/
+        {
+            room->numTriangles = read_element_count(&roomData, SIZE_TR_ROOM_TRIANGLE);
+            room->triangles = arena_alloc(level->roomArena, (sizeof(struct tr_triangle_s) * room->numTriangles));
+
+            for (p = 0; p < room->numTriangles; p++)
+            {
+                int16_t textureIdx = 0;
+
+                room->triangles[p].vertexIdx[0] = read_vertex_idx(&roomData, vertices->numVertices);
+                room->triangles[p].vertexIdx[1] = read_vertex_idx(&roomData, vertices->numVertices);
+                room->triangles[p].vertexIdx[2] = read_vertex_idx(&roomData, vertices->numVertices);
+                textureIdx = read_int16(&roomData);
+
+                room->triangles[p].isDoubleSided = (textureIdx & 0x8000);
+                room->triangles[p].textureIdx = (textureIdx & 0x7fff);
+            }
+        }
+    }
+
+    /* Static room meshes.*/
+    seek_to(&staticObjectData, index->staticObjectsOffset);
+    room->staticObjects = arena_alloc(level->roomArena, (sizeof(struct tr_mesh_meta_s) * room->numStaticObjects));
+    for (p = 0; p < room->numStaticObjects; p++)
+    {
+        room->staticObjects[p].x = read_value(&staticObjectData, 4);
+        room->staticObjects[p].y = read_value(&staticObjectData, 4);
+        room->staticObjects[p].z = read_value(&staticObjectData, 4);
+        room->staticObjects[p].rotation = ((read_value(&staticObjectData, 2) & 0xc000) >> 14);
+        room->staticObjects[p].lighting = read_value(&staticObjectData, 2);
+        room->staticObjects[p].meshIdx = read_value(&staticObjectData, 2);
+    }
+
+    check_cursor(level, &roomData);
+    check_cursor(level, &staticObjectData);
+
+    return;
+}
+
+void decode_room_task(void *const context, const unsigned taskIdx)
+{
+    const struct room_decode_context_s *const decodeContext = context;
+
+    if (!decodeContext->level->importedData.roomIsSelected[taskIdx])
+    {
+        return;
+    }
+
+    decode_room(decodeContext->level, taskIdx, &decodeContext->roomIndex[taskIdx]);
+
+    return;
+}
+
+/* Decodes the given object mesh out of the level's raw mesh data array, given the
+ * array and the list of each mesh's offset into it.*/
+void decode_mesh(struct level_s *const level,
+                 const unsigned meshIdx,
+                 const struct data_cursor_s *const meshDataArray,
+                 const struct data_cursor_s *const meshOffsetList)
+{
+    struct tr_mesh_s *const objectMesh = &level->importedData.meshes[meshIdx];
+    struct tr_vertex_buffer_s *const vertices = &objectMesh->vertices;
+    struct data_cursor_s meshData = *meshDataArray;
+    struct data_cursor_s meshOffsets = *meshOffsetList;
+    int numNormals = 0;
+    unsigned p = 0;
+
+    seek_to(&meshOffsets, (sizeof(uint32_t) * meshIdx));
+    seek_to(&meshData, (uint32_t)read_value(&meshOffsets, 4));
+
+    /* Skip vertex 'center'.*/
+    skip_num_bytes(&meshData, SIZE_TR_VERTEX);
+
+    /* Skip uint32_t collisionRadius.*/
+    skip_num_bytes(&meshData, sizeof(uint32_t));
+
+    /* Object meshes have no pre-baked lighting.*/
+    alloc_vertex_buffer(&level->arena, vertices, read_element_count(&meshData, SIZE_TR_VERTEX), 0);
+    for (p = 0; p < vertices->numVertices; p++)
+    {
+        vertices->x[p] = read_int16(&meshData);
+        vertices->y[p] = read_int16(&meshData);
+        vertices->z[p] = read_int16(&meshData);
+    }
+
+    numNormals = read_int16(&meshData);
+    if (numNormals > 0) /* Normals*/
+    {
+        for (p = 0; p < numNormals; p++)
+        {
+            const int x = read_int16(&meshData);
+            const int y = read_int16(&meshData);
+            const int z = read_int16(&meshData);
+
+            /* Convert into a floating-point normal vector.*/
+            const float nx = (x / 16384.0);
+            const float ny = (y / 16384.0);
+            const float nz = (z / 16384.0);
+
+            /* Normals aren't exported anywhere at the moment, so let's just ignore them.*/
+            (void)nx;
+            (void)ny;
+            (void)nz;
+        }
+    }
+    else /* Lights.*/
+    {
+        numNormals = abs(numNormals);
+        skip_num_bytes(&meshData, (numNormals * 2));
+    }
+
+    /* Each face is its vertex indices followed by its texture index, 16 bits each.*/
+    #define LOAD_OBJECT_MESH_FACES(dstMeshArray, numFaces, numVertsPerFace)\
+            numFaces = read_element_count(&meshData, ((numVertsPerFace + 1) * 2));\
+            dstMeshArray = arena_alloc(&level->arena, (sizeof(*dstMeshArray) * numFaces));\
+            for (p = 0; p < numFaces; p++)\
+            {\
+                unsigned v = 0;\
+                for (v = 0; v < numVertsPerFace; v++)\
+                {\
+                    dstMeshArray[p].vertexIdx[v] = read_vertex_idx(&meshData, vertices->numVertices);\
+                }\
+                dstMeshArray[p].isDoubleSided = 0;\
+                dstMeshArray[p].textureIdx = read_int16(&meshData);\
+            }
+
+    LOAD_OBJECT_MESH_FACES(objectMesh->texturedQuads, objectMesh->numTexturedQuads, 4);
+    LOAD_OBJECT_MESH_FACES(objectMesh->texturedTriangles, objectMesh->numTexturedTriangles, 3);
+    LOAD_OBJECT_MESH_FACES(objectMesh->untexturedQuads, objectMesh->numUntexturedQuads, 4);
+    LOAD_OBJECT_MESH_FACES(objectMesh->untexturedTriangles, objectMesh->numUntexturedTriangles, 3);
+
+    #undef LOAD_OBJECT_MESH_FACES
+
+    check_cursor(level, &meshData);
+    check_cursor(level, &meshOffsets);
+
+    return;
+}
+
+/* Selects for export the object textures that the given decoded room and its
+ * static objects use.*/
+void select_room_textures(const struct level_s *const level, const unsigned roomIdx)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const struct tr_room_mesh_s *const room = &importedData->roomMeshes[roomIdx];
+    unsigned j = 0, p = 0;
+
+    #define SELECT_FACE_TEXTURES(numFaces, faces)\
+            for (j = 0; j < numFaces; j++)\
+            {\
+                if ((faces[j].textureIdx >= 0) &&\
+                    (faces[j].textureIdx < importedData->numObjectTextures))\
+                {\
+                    importedData->objectTextureIsSelected[faces[j].textureIdx] = 1;\
+                }\
+            }
+
+    SELECT_FACE_TEXTURES(room->numQuads, room->quads);
+    SELECT_FACE_TEXTURES(room->numTriangles, room->triangles);
+
+    for (p = 0; p < room->numStaticObjects; p++)
+    {
+        const struct tr_mesh_s *const object = &importedData->meshes[room->staticObjects[p].meshIdx];
+
+        SELECT_FACE_TEXTURES(object->numTexturedQuads, object->texturedQuads);
+        SELECT_FACE_TEXTURES(object->numTexturedTriangles, object->texturedTriangles);
+    }
+
+    #undef SELECT_FACE_TEXTURES
+
+    return;
+}
+
+/* Selects for export the texture images that the selected object textures use.*/
+void select_texture_images(const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    unsigned i = 0;
+
+    for (i = 0; i < importedData->numObjectTextures; i++)
+    {
+        if (importedData->objectTextureIsSelected[i])
+        {
+            importedData->textureImageIsSelected[importedData->objectTextures[i].imageIdx] = 1;
+        }
+    }
+
+    return;
+}
+
+/* Selects for export the object textures, and the texture images they use, that
+ * are to be exported: either all of them, or only those that the selected rooms
+ * (and their static objects) use if a list of rooms was given.*/
+void select_object_textures(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    unsigned i = 0;
+
+    importedData->objectTextureIsSelected = arena_alloc(&level->arena, importedData->numObjectTextures);
+    importedData->textureImageIsSelected = arena_alloc(&level->arena, importedData->numTextureImages);
+    memset(importedData->textureImageIsSelected, 0, importedData->numTextureImages);
+
+    if (!(level->exportParts & EXPORT_OBJECT_TEXTURES))
+    {
+        memset(importedData->objectTextureIsSelected, 0, importedData->numObjectTextures);
+        return;
+    }
+
+    memset(importedData->objectTextureIsSelected, !level->roomList, importedData->numObjectTextures);
+
+    for (i = 0; (i < importedData->numRoomMeshes) && level->roomList; i++)
+    {
+        if (importedData->roomIsSelected[i])
+        {
+            select_room_textures(level, i);
+        }
+    }
+
+    select_texture_images(level);
+
+    return;
+}
+
+/* The byte size of each element of each level section. The rooms are of
+ * variable length, and are instead indexed one by one.*/
+static const unsigned LEVEL_SECTION_ELEMENT_SIZES[NUM_LEVEL_SECTIONS] =
+{
+    (256 * 256), 0, 2, 2, sizeof(uint32_t), SIZE_TR_ANIMATION, SIZE_TR_STATE_CHANGE,
+    SIZE_TR_ANIM_DISPATCH, SIZE_TR_ANIM_COMMANDS, SIZE_TR_MESH_TREE_NODE, 2, SIZE_TR_MODEL,
+    SIZE_TR_STATIC_MESH, SIZE_TR_OBJECT_TEXTURE, SIZE_TR_SPRITE_TEXTURE, SIZE_TR_SPRITE_SEQUENCE,
+    SIZE_TR_CAMERA, SIZE_TR_SOUND_SOURCE, SIZE_TR_BOX, 2,
+    (6 * 2), /* Six zones of 16 bits per box.*/
+    2, SIZE_TR_ENTITY, 1, 3, SIZE_TR_CINEMATIC_FRAME, 1
+};
+
+/* Records where the section beginning at the current read position is, given
+ * how many elements it has, and skips past it.*/
+void index_section(struct level_s *const level, const unsigned sectionId, const unsigned count)
+{
+    const char *const sectionNames[NUM_LEVEL_SECTIONS] =
+    {
+        "Texture atlases", "Rooms", "Floors", "Mesh data", "Meshes", "Animations",
+        "State changes", "Animation dispatches", "Animation commands", "Mesh trees",
+        "Frames", "Models", "Static meshes", "Object textures", "Sprite textures",
+        "Sprite sequences", "Cameras", "Sound sources", "Boxes", "Overlaps", "Zones",
+        "Animated textures", "Entities", "Light map", "Palette", "Cinematic frames",
+        "Demo data"
+    };
+
+    level->toc.sections[sectionId].offset = level->inputFile.pos;
+    level->toc.sections[sectionId].count = count;
+    log_section(level, 0, " %s: %u\n", sectionNames[sectionId], count);
+
+    skip_num_bytes(&level->inputFile, ((size_t)LEVEL_SECTION_ELEMENT_SIZES[sectionId] * count));
+
+    return;
+}
+
+/* Walks through the level file, recording where each of its sections and rooms
+ * are into the level's table of contents.*/
+void index_level_file(struct level_s *const level)
+{
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    struct level_toc_s *const toc = &level->toc;
+    size_t releasedEnd = 0;
+    unsigned numRooms = 0;
+    unsigned numBoxes = 0;
+    unsigned i = 0;
+
+    seek_to(inputFile, 0);
+    if (read_value(inputFile, 4) != 32)
+    {
+        set_level_error(level, DIG_ERROR_MALFORMED);
+        return;
+    }
+
+    index_section(level, LEVEL_SECTION_TEXTURE_ATLASES, read_value(inputFile, 4));
+
+    /* Skip unknown dword.*/
+    skip_num_bytes(inputFile, 4);
+
+    /* The rooms are variable-length records, so each needs to be walked through.*/
+    numRooms = read_value(inputFile, 2);
+    index_section(level, LEVEL_SECTION_ROOMS, numRooms);
+    toc->rooms = arena_alloc(&level->arena, (sizeof(struct room_index_s) * numRooms));
+    for (i = 0; i < numRooms; i++)
+    {
+        index_room(level, i, &toc->rooms[i]);
+        release_input_behind(level, &releasedEnd, inputFile->pos);
+    }
+
+    index_section(level, LEVEL_SECTION_FLOORS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_MESH_DATA, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_MESH_POINTERS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_ANIMATIONS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_STATE_CHANGES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_ANIMATION_DISPATCHES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_ANIMATION_COMMANDS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_MESH_TREES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_FRAMES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_MODELS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_STATIC_MESHES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_OBJECT_TEXTURES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_SPRITE_TEXTURES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_SPRITE_SEQUENCES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_CAMERAS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_SOUND_SOURCES, read_value(inputFile, 4));
+
+    numBoxes = read_value(inputFile, 4);
+    index_section(level, LEVEL_SECTION_BOXES, numBoxes);
+    index_section(level, LEVEL_SECTION_OVERLAPS, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_ZONES, numBoxes);
+
+    index_section(level, LEVEL_SECTION_ANIMATED_TEXTURES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_ENTITIES, read_value(inputFile, 4));
+    index_section(level, LEVEL_SECTION_LIGHT_MAP, 8192);
+    index_section(level, LEVEL_SECTION_PALETTE, 256);
+    index_section(level, LEVEL_SECTION_CINEMATIC_FRAMES, read_value(inputFile, 2));
+    index_section(level, LEVEL_SECTION_DEMO_DATA, read_value(inputFile, 2));
+
+    /* The rest of the file (sound data) isn't needed.*/
+
+    check_cursor(level, inputFile);
+
+    return;
+}
+
+/* Selects the rooms to be decoded: all of them, or those in the level's list of
+ * rooms; or none if their geometry isn't needed.*/
+void select_rooms(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+
+    /* The rooms' geometry is needed to export them, or to find out which
+     * object textures they use.*/
+    const unsigned decodeRooms = ((level->exportParts & EXPORT_ROOM_MESHES) ||
+                                  (level->roomList && (level->exportParts & EXPORT_OBJECT_TEXTURES)));
+
+    importedData->numRoomMeshes = level->toc.sections[LEVEL_SECTION_ROOMS].count;
+
+    importedData->roomMeshes = arena_alloc(&level->arena, (sizeof(struct tr_room_mesh_s) * importedData->numRoomMeshes));
+    memset(importedData->roomMeshes, 0, (sizeof(struct tr_room_mesh_s) * importedData->numRoomMeshes));
+
+    importedData->roomIsSelected = arena_alloc(&level->arena, importedData->numRoomMeshes);
+    memset(importedData->roomIsSelected, (!level->roomList && decodeRooms), importedData->numRoomMeshes);
+
+    if (level->roomList && decodeRooms &&
+        (parse_index_list(level->roomList, importedData->roomIsSelected, importedData->numRoomMeshes) != 0))
+    {
+        fprintf(stderr, "%s: Ignoring the selected rooms past the level's last room (#%d).\n",
+                level->inputFilename, (importedData->numRoomMeshes - 1));
+    }
+
+    return;
+}
+
+/* Reads the level's static mesh records into the given table, which maps a
+ * static mesh's ID to its record's index, and returns a newly allocated list
+ * giving each record's index into the master list of meshes.*/
+unsigned* load_static_mesh_table(struct level_s *const level, struct weld_table_s *const staticMeshIds)
+{
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    const unsigned numStaticMeshes = level->toc.sections[LEVEL_SECTION_STATIC_MESHES].count;
+    unsigned *const meshIdxs = malloc(sizeof(unsigned) * (numStaticMeshes? numStaticMeshes : 1));
+    unsigned i = 0;
+
+    assert(meshIdxs && "Failed to allocate memory for the static mesh table.");
+
+    seek_to(inputFile, level->toc.sections[LEVEL_SECTION_STATIC_MESHES].offset);
+    weld_table_init(staticMeshIds, 1, numStaticMeshes);
+
+    for (i = 0; i < numStaticMeshes; i++)
+    {
+        const uint32_t staticMeshId = read_value(inputFile, 4); /* A value identifying this static mesh.*/
+        const unsigned meshIdx = read_value(inputFile, 2);      /* Index to the master list of meshes (importedData->meshes).*/
+        const unsigned numKnownIds = staticMeshIds->numKeys;
+        skip_num_bytes(inputFile, 12); /* Skip 'visibilityBox'.*/
+        skip_num_bytes(inputFile, 12); /* Skip 'collisionBox'. */
+        skip_num_bytes(inputFile, 2);  /* Skip 'flags'.        */
+
+        /* If an ID is repeated, its first record wins.*/
+        if (weld_table_insert(staticMeshIds, &staticMeshId) == numKnownIds)
+        {
+            meshIdxs[numKnownIds] = meshIdx;
+        }
+    }
+
+    return meshIdxs;
+}
+
+/* Returns the index into the master list of meshes of the static mesh by the
+ * given ID, or WELD_TABLE_NOT_FOUND if there's no such static mesh.*/
+unsigned find_static_mesh(const struct level_s *const level,
+                          const struct weld_table_s *const staticMeshIds,
+                          const unsigned *const meshIdxs,
+                          const uint32_t staticMeshId)
+{
+    const unsigned recordIdx = weld_table_find(staticMeshIds, &staticMeshId);
+
+    if ((recordIdx == WELD_TABLE_NOT_FOUND) ||
+        (meshIdxs[recordIdx] >= level->importedData.numMeshes))
+    {
+        return WELD_TABLE_NOT_FOUND;
+    }
+
+    return meshIdxs[recordIdx];
+}
+
+/* Routes the master mesh index information directly to the given decoded room's
+ * static objects. Normally, the static objects have an index referring to the
+ * static mesh records, which then refer to the master mesh list. Static objects
+ * whose mesh can't be found are dropped.*/
+void resolve_static_objects(const struct level_s *const level,
+                            const unsigned roomIdx,
+                            const struct weld_table_s *const staticMeshIds,
+                            const unsigned *const meshIdxs)
+{
+    struct tr_room_mesh_s *const room = &level->importedData.roomMeshes[roomIdx];
+    unsigned numResolved = 0;
+    unsigned p = 0;
+
+    for (p = 0; p < room->numStaticObjects; p++)
+    {
+        const uint32_t staticMeshId = room->staticObjects[p].meshIdx;
+        const unsigned meshIdx = find_static_mesh(level, staticMeshIds, meshIdxs, staticMeshId);
+
+        if (meshIdx == WELD_TABLE_NOT_FOUND)
+        {
+            fprintf(stderr, "%s: Room #%d: dropping static object #%d, which refers to an unknown static mesh (ID %u).\n",
+                    level->inputFilename, roomIdx, p, staticMeshId);
+            continue;
+        }
+
+        room->staticObjects[numResolved] = room->staticObjects[p];
+        room->staticObjects[numResolved].meshIdx = meshIdx;
+        numResolved++;
+    }
+
+    room->numStaticObjects = numResolved;
+
+    return;
+}
+
+/* Locates the level's raw mesh data array and each mesh's offset into it, and
+ * allocates the master list of meshes, none of which are decoded yet.*/
+void locate_meshes(struct level_s *const level,
+                   struct data_cursor_s *const meshData,
+                   struct data_cursor_s *const meshOffsets)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    const struct level_toc_s *const toc = &level->toc;
+
+    seek_to(inputFile, toc->sections[LEVEL_SECTION_MESH_DATA].offset);
+    *meshData = read_section(inputFile, (toc->sections[LEVEL_SECTION_MESH_DATA].count * 2));
+
+    importedData->numMeshes = toc->sections[LEVEL_SECTION_MESH_POINTERS].count;
+    importedData->meshes = arena_alloc(&level->arena, (sizeof(struct tr_mesh_s) * importedData->numMeshes));
+    memset(importedData->meshes, 0, (sizeof(struct tr_mesh_s) * importedData->numMeshes));
+
+    importedData->meshIsSelected = arena_alloc(&level->arena, (importedData->numMeshes + 1));
+    memset(importedData->meshIsSelected, 0, (importedData->numMeshes + 1));
+
+    seek_to(inputFile, toc->sections[LEVEL_SECTION_MESH_POINTERS].offset);
+    *meshOffsets = read_section(inputFile, (sizeof(uint32_t) * importedData->numMeshes));
+
+    return;
+}
+
+/* Decodes the meshes selected for export.*/
+void decode_selected_meshes(struct level_s *const level,
+                            const struct data_cursor_s *const meshData,
+                            const struct data_cursor_s *const meshOffsets)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    unsigned i = 0;
+
+    for (i = 0; i < importedData->numMeshes; i++)
+    {
+        if (importedData->meshIsSelected[i])
+        {
+            decode_mesh(level, i, meshData, meshOffsets);
+            stats_count_faces(level, mesh_num_faces(&importedData->meshes[i]));
+        }
+    }
+
+    return;
+}
+
+/* Reads the object textures' metadata and finds the distinct texture images
+ * that they use, without copying the images' pixels out of the atlases.*/
+void read_object_textures(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    struct weld_table_s imageRects;
+    unsigned i = 0, p = 0;
+
+    importedData->numObjectTextures = level->toc.sections[LEVEL_SECTION_OBJECT_TEXTURES].count;
+    seek_to(inputFile, level->toc.sections[LEVEL_SECTION_OBJECT_TEXTURES].offset);
+
+    importedData->objectTextures = arena_alloc(&level->arena, (sizeof(struct tr_object_texture_s) * importedData->numObjectTextures));
+
+    /* In the worst case, each object texture has an image of its own.*/
+    importedData->numTextureImages = 0;
+    importedData->textureImages = arena_alloc(&level->arena, (sizeof(struct tr_texture_image_s) * importedData->numObjectTextures));
+    weld_table_init(&imageRects, 5, importedData->numObjectTextures);
+
+    for (i = 0; i < importedData->numObjectTextures; i++)
+    {
+        struct tr_object_texture_s *const texture = &importedData->objectTextures[i];
+        unsigned textureAtlasIdx = 0;
+        unsigned isTriangle = 0;
+        unsigned attribute = 0;
+
+        attribute = read_value(inputFile, 2);
+        textureAtlasIdx = read_value(inputFile, 2);
+        isTriangle = (textureAtlasIdx & 0x1);
+        textureAtlasIdx = (textureAtlasIdx & 0x7fff);
+        texture->hasAlpha = ((attribute == 1) || (attribute == 4));
+        texture->ignoresDepthTest = (attribute == 4);
+        texture->hasWireframe = (attribute == 6);
+        texture->pixelData = NULL;
+
+        if (textureAtlasIdx >= importedData->numTextureAtlases)
+        {
+            set_level_error(level, DIG_ERROR_MALFORMED);
+            break;
+        }
+
+        /* Find the texture's rectangle in the texture atlas, and the texture
+         * image by that rectangle, unless another object texture has already
+         * found it.*/
+        {
+            unsigned minX = ~0u, maxX = 0, minY = ~0u, maxY = 0;
+            uint32_t imageRect[5];
+            unsigned cornerPoints[4][2] = {0}; /* 4 texel coordinate pairs defining this texture's rectangle in the texture atlas.*/
+
+            for (p = 0; p < 4; p++)
+            {
+                const unsigned x = read_value(inputFile, 2);
+                const unsigned y = read_value(inputFile, 2);
+
+                cornerPoints[p][0] = (unsigned)((x & 0xff00) / 256.0);
+                cornerPoints[p][1] = (unsigned)((y & 0xff00) / 256.0);
+
+                texture->u[3-p] = ((x & 0xff) / 256.0);
+                texture->v[3-p] = ((y & 0xff) / 256.0);
+            }
+
+            for (p = 0; p < (isTriangle? 3 : 4); p++)
+            {
+                if (cornerPoints[p][0] > maxX) maxX = cornerPoints[p][0];
+                if (cornerPoints[p][0] < minX) minX = cornerPoints[p][0];
+
+                if (cornerPoints[p][1] > maxY) maxY = cornerPoints[p][1];
+                if (cornerPoints[p][1] < minY) minY = cornerPoints[p][1];
+            }
+            
+            texture->width = ((maxX - minX) + 1);
+            texture->height = ((maxY - minY) + 1);
+
+            imageRect[0] = textureAtlasIdx;
+            imageRect[1] = minX;
+            imageRect[2] = minY;
+            imageRect[3] = texture->width;
+            imageRect[4] = texture->height;
+            texture->imageIdx = weld_table_insert(&imageRects, imageRect);
+
+            if (texture->imageIdx == importedData->numTextureImages)
+            {
+                struct tr_texture_image_s *const image = &importedData->textureImages[importedData->numTextureImages++];
+
+                image->atlasIdx = textureAtlasIdx;
+                image->x = minX;
+                image->y = minY;
+                image->width = texture->width;
+                image->height = texture->height;
+                image->pixelData = NULL;
+                image->pageIdx = TEXTURE_PAGE_NONE;
+            }
+        }
+    }
+
+    weld_table_free(&imageRects);
+    log_section(level, 0, "   Unique images: %d\n", importedData->numTextureImages);
+
+    check_cursor(level, inputFile);
+
+    return;
+}
+
+/* Copies the given texture image's pixels out of its texture atlas into memory
+ * from the given arena, and points the object textures that use the image to
+ * them.*/
+void copy_texture_image(struct level_s *const level, struct arena_s *const arena, const unsigned imageIdx)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    struct tr_texture_image_s *const image = &importedData->textureImages[imageIdx];
+    const struct tr_texture_atlas_s *const atlas = &importedData->textureAtlases[image->atlasIdx];
+    unsigned p = 0;
+
+    image->pixelData = arena_alloc(arena, (image->width * image->height));
+
+    /* Copy the pixel data row by row.*/
+    for (p = 0; p < image->height; p++)
+    {
+        const unsigned srcIdx = (image->x + (image->y + p) * atlas->width);
+        const unsigned dstIdx = (p * image->width);
+
+        memcpy((image->pixelData + dstIdx), (atlas->pixelData + srcIdx), image->width);
+    }
+
+    return;
+}
+
+/* Points each object texture to the pixels of its texture image, or to NULL if
+ * they haven't been copied.*/
+void link_object_texture_pixels(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    unsigned i = 0;
+
+    for (i = 0; i < importedData->numObjectTextures; i++)
+    {
+        importedData->objectTextures[i].pixelData = importedData->textureImages[importedData->objectTextures[i].imageIdx].pixelData;
+    }
+
+    return;
+}
+
+/* Orders texture images for packing: tallest first, then widest first, then
+ * in order of index.*/
+int compare_packing_items(const void *const a, const void *const b)
+{
+    const struct packing_item_s *const itemA = a;
+    const struct packing_item_s *const itemB = b;
+
+    if (itemA->height != itemB->height) return ((itemA->height > itemB->height)? -1 : 1);
+    if (itemA->width != itemB->width) return ((itemA->width > itemB->width)? -1 : 1);
+
+    return ((itemA->imageIdx < itemB->imageIdx)? -1 : 1);
+}
+
+/* Returns the height on the given skyline at which a rectangle of the given
+ * width would rest with its left edge at the start of the given segment; or
+ * TEXTURE_PAGE_NONE if the rectangle would stick out of the page's right side.*/
+unsigned skyline_fit(const struct texture_skyline_s *const skyline, const unsigned segmentIdx, const unsigned width)
+{
+    unsigned y = 0, remaining = width, i = segmentIdx;
+
+    if ((skyline->segments[segmentIdx].x + width) > TEXTURE_PAGE_MAX_SIZE)
+    {
+        return TEXTURE_PAGE_NONE;
+    }
+
+    for (i = segmentIdx; (i < skyline->numSegments) && remaining; i++)
+    {
+        if (skyline->segments[i].y > y)
+        {
+            y = skyline->segments[i].y;
+        }
+
+        remaining -= ((skyline->segments[i].width < remaining)? skyline->segments[i].width : remaining);
+    }
+
+    return y;
+}
+
+/* Raises the given skyline over a rectangle of the given size placed at the
+ * start of the given segment, at the given height.*/
+void skyline_add(struct texture_skyline_s *const skyline,
+                 const unsigned segmentIdx,
+                 const unsigned width,
+                 const unsigned height,
+                 const unsigned y)
+{
+    struct skyline_segment_s *segments = NULL;
+    const unsigned x = skyline->segments[segmentIdx].x;
+    unsigned i = 0;
+
+    if (skyline->numSegments == skyline->capacity)
+    {
+        skyline->capacity *= 2;
+        skyline->segments = realloc(skyline->segments, (sizeof(struct skyline_segment_s) * skyline->capacity));
+        assert(skyline->segments && "Failed to allocate memory for packing textures.");
+    }
+
+    segments = skyline->segments;
+
+    memmove(&segments[segmentIdx + 1], &segments[segmentIdx], (sizeof(struct skyline_segment_s) * (skyline->numSegments - segmentIdx)));
+    segments[segmentIdx].x = x;
+    segments[segmentIdx].y = (y + height);
+    segments[segmentIdx].width = width;
+    skyline->numSegments++;
+
+    /* Cut the segments that are now under the rectangle.*/
+    i = (segmentIdx + 1);
+    while (i < skyline->numSegments)
+    {
+        if ((segments[i].x + segments[i].width) <= (x + width))
+        {
+            memmove(&segments[i], &segments[i + 1], (sizeof(struct skyline_segment_s) * (skyline->numSegments - i - 1)));
+            skyline->numSegments--;
+        }
+        else
+        {
+            if (segments[i].x < (x + width))
+            {
+                segments[i].width -= ((x + width) - segments[i].x);
+                segments[i].x = (x + width);
+            }
+
+            break;
+        }
+    }
+
+    /* Merge neighboring segments of the same height.*/
+    for (i = 1; i < skyline->numSegments; )
+    {
+        if (segments[i - 1].y == segments[i].y)
+        {
+            segments[i - 1].width += segments[i].width;
+            memmove(&segments[i], &segments[i + 1], (sizeof(struct skyline_segment_s) * (skyline->numSegments - i - 1)));
+            skyline->numSegments--;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if ((x + width) > skyline->usedWidth) skyline->usedWidth = (x + width);
+    if ((y + height) > skyline->usedHeight) skyline->usedHeight = (y + height);
+
+    return;
+}
+
+/* Places the given rectangle on the given skyline at its lowest (and then
+ * leftmost) spot. Returns 0 if the rectangle doesn't fit on the page.*/
+int skyline_place(struct texture_skyline_s *const skyline,
+                  const unsigned width,
+                  const unsigned height,
+                  unsigned *const x,
+                  unsigned *const y)
+{
+    unsigned bestSegment = TEXTURE_PAGE_NONE, bestY = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < skyline->numSegments; i++)
+    {
+        const unsigned fitY = skyline_fit(skyline, i, width);
+
+        if ((fitY != TEXTURE_PAGE_NONE) &&
+            ((fitY + height) <= TEXTURE_PAGE_MAX_SIZE) &&
+            ((bestSegment == TEXTURE_PAGE_NONE) || (fitY < bestY)))
+        {
+            bestSegment = i;
+            bestY = fitY;
+        }
+    }
+
+    if (bestSegment == TEXTURE_PAGE_NONE)
+    {
+        return 0;
+    }
+
+    *x = skyline->segments[bestSegment].x;
+    *y = bestY;
+    skyline_add(skyline, bestSegment, width, height, bestY);
+
+    return 1;
+}
+
+unsigned next_power_of_two(const unsigned value)
+{
+    unsigned result = 1;
+
+    while (result < value)
+    {
+        result *= 2;
+    }
+
+    return result;
+}
+
+/* Repacks the level's texture images, with TEXTURE_PAGE_PADDING pixels around
+ * each, into as few texture pages as they fit in, and remaps the object
+ * textures' UV coordinates onto the pages. All of the images are packed, not
+ * only the selected ones, so that the pages don't depend on which rooms are
+ * exported. The pages' pixels aren't drawn; see draw_texture_pages().*/
+void pack_texture_pages(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    struct packing_item_s *items = NULL;
+    struct texture_skyline_s *skylines = NULL;
+    unsigned numSkylines = 0;
+    unsigned i = 0, p = 0;
+
+    items = malloc(sizeof(struct packing_item_s) * (importedData->numTextureImages + 1));
+    skylines = malloc(sizeof(struct texture_skyline_s) * (importedData->numTextureImages + 1));
+    assert((items && skylines) && "Failed to allocate memory for packing textures.");
+
+    for (i = 0; i < importedData->numTextureImages; i++)
+    {
+        items[i].width = (importedData->textureImages[i].width + (TEXTURE_PAGE_PADDING * 2));
+        items[i].height = (importedData->textureImages[i].height + (TEXTURE_PAGE_PADDING * 2));
+        items[i].imageIdx = i;
+    }
+
+    qsort(items, importedData->numTextureImages, sizeof(struct packing_item_s), compare_packing_items);
+
+    /* Place each image on the first page with room for it, opening a new page
+     * when there's none.*/
+    for (i = 0; i < importedData->numTextureImages; i++)
+    {
+        struct tr_texture_image_s *const image = &importedData->textureImages[items[i].imageIdx];
+        unsigned x = 0, y = 0;
+
+        for (p = 0; p < numSkylines; p++)
+        {
+            if (skyline_place(&skylines[p], items[i].width, items[i].height, &x, &y))
+            {
+                break;
+            }
+        }
+
+        if (p == numSkylines)
+        {
+            struct texture_skyline_s *const skyline = &skylines[numSkylines++];
+
+            skyline->numSegments = 1;
+            skyline->capacity = 16;
+            skyline->segments = malloc(sizeof(struct skyline_segment_s) * skyline->capacity);
+            assert(skyline->segments && "Failed to allocate memory for packing textures.");
+            skyline->segments[0].x = 0;
+            skyline->segments[0].y = 0;
+            skyline->segments[0].width = TEXTURE_PAGE_MAX_SIZE;
+            skyline->usedWidth = 0;
+            skyline->usedHeight = 0;
+
+            /* An image is at most 256 pixels a side, so it fits on an empty page.*/
+            skyline_place(skyline, items[i].width, items[i].height, &x, &y);
+        }
+
+        image->pageIdx = p;
+        image->pageX = (x + TEXTURE_PAGE_PADDING);
+        image->pageY = (y + TEXTURE_PAGE_PADDING);
+    }
+
+    importedData->numTexturePages = numSkylines;
+    importedData->texturePages = arena_alloc(&level->arena, (sizeof(struct tr_texture_page_s) * (numSkylines + 1)));
+
+    for (p = 0; p < numSkylines; p++)
+    {
+        importedData->texturePages[p].width = next_power_of_two(skylines[p].usedWidth);
+        importedData->texturePages[p].height = next_power_of_two(skylines[p].usedHeight);
+        importedData->texturePages[p].pixelData = NULL;
+
+        free(skylines[p].segments);
+    }
+
+    /* Move the UV coordinates from the images onto the pages.*/
+    for (i = 0; i < importedData->numObjectTextures; i++)
+    {
+        struct tr_object_texture_s *const texture = &importedData->objectTextures[i];
+        const struct tr_texture_image_s *const image = &importedData->textureImages[texture->imageIdx];
+        const struct tr_texture_page_s *const page = &importedData->texturePages[image->pageIdx];
+
+        for (p = 0; p < 4; p++)
+        {
+            texture->u[p] = ((image->pageX + (texture->u[p] * image->width)) / page->width);
+            texture->v[p] = ((image->pageY + (texture->v[p] * image->height)) / page->height);
+        }
+    }
+
+    log_section(level, 0, "   Texture pages: %u\n", numSkylines);
+
+    free(items);
+    free(skylines);
+
+    return;
+}
+
+/* Allocates the texture pages' pixels from the given arena, cleared to palette
+ * index 0, which is transparent.*/
+void alloc_texture_pages(const struct level_s *const level, struct arena_s *const arena)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    unsigned i = 0;
+
+    for (i = 0; i < importedData->numTexturePages; i++)
+    {
+        struct tr_texture_page_s *const page = &importedData->texturePages[i];
+
+        page->pixelData = arena_alloc(arena, (page->width * page->height));
+        memset(page->pixelData, 0, (page->width * page->height));
+    }
+
+    return;
+}
+
+/* Draws the texture images cut out of the given texture atlas onto their texture
+ * pages, repeating each image's edge pixels into its padding.*/
+void draw_texture_pages(const struct level_s *const level, const unsigned atlasIdx)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const struct tr_texture_atlas_s *const atlas = &importedData->textureAtlases[atlasIdx];
+    unsigned i = 0, y = 0;
+
+    for (i = 0; i < importedData->numTextureImages; i++)
+    {
+        const struct tr_texture_image_s *const image = &importedData->textureImages[i];
+        const struct tr_texture_page_s *const page = &importedData->texturePages[image->pageIdx];
+
+        if (image->atlasIdx != atlasIdx)
+        {
+            continue;
+        }
+
+        for (y = 0; y < (image->height + (TEXTURE_PAGE_PADDING * 2)); y++)
+        {
+            const unsigned srcY = ((y < TEXTURE_PAGE_PADDING)? 0 :
+                                   ((y - TEXTURE_PAGE_PADDING) >= image->height)? (image->height - 1) :
+                                   (y - TEXTURE_PAGE_PADDING));
+            const uint8_t *const src = (atlas->pixelData + ((image->y + srcY) * atlas->width) + image->x);
+            uint8_t *const dst = (page->pixelData +
+                                  ((image->pageY - TEXTURE_PAGE_PADDING + y) * page->width) +
+                                  (image->pageX - TEXTURE_PAGE_PADDING));
+
+            memset(dst, src[0], TEXTURE_PAGE_PADDING);
+            memcpy((dst + TEXTURE_PAGE_PADDING), src, image->width);
+            memset((dst + TEXTURE_PAGE_PADDING + image->width), src[image->width - 1], TEXTURE_PAGE_PADDING);
+        }
+    }
+
+    return;
+}
+
+/* Reads the level's texture atlases, which are used from the level file as is.*/
+void read_texture_atlases(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    unsigned i = 0;
+
+    importedData->numTextureAtlases = level->toc.sections[LEVEL_SECTION_TEXTURE_ATLASES].count;
+    importedData->textureAtlases = arena_alloc(&level->arena, (sizeof(struct tr_texture_atlas_s) * importedData->numTextureAtlases));
+    seek_to(inputFile, level->toc.sections[LEVEL_SECTION_TEXTURE_ATLASES].offset);
+
+    for (i = 0; i < importedData->numTextureAtlases; i++)
+    {
+        unsigned numPixels;
+
+        importedData->textureAtlases[i].width = 256;
+        importedData->textureAtlases[i].height = 256;
+        numPixels = (importedData->textureAtlases[i].width * importedData->textureAtlases[i].height);
+
+        importedData->textureAtlases[i].pixelData = read_bytes(inputFile, numPixels);
+    }
+
+    check_cursor(level, inputFile);
+
+    return;
+}
+
+/* Reads the level's palette, converting its colors from VGA 6-bit to full 8-bit.*/
+void read_palette(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    const uint8_t *palette = NULL;
+    unsigned i = 0;
+
+    seek_to(&level->inputFile, level->toc.sections[LEVEL_SECTION_PALETTE].offset);
+    if (!(palette = read_bytes(&level->inputFile, 768)))
+    {
+        set_level_error(level, DIG_ERROR_MALFORMED);
+        return;
+    }
+
+    importedData->palette = arena_alloc(&level->arena, 768);
+
+    for (i = 0; i < 768; i++)
+    {
+        importedData->palette[i] = (palette[i] * 4);
+    }
+
+    return;
+}
+
+/* Reads the level file's version, which must be that of Tomb Raider 1.*/
+void read_file_version(struct level_s *const level)
+{
+    seek_to(&level->inputFile, 0);
+    level->importedData.fileVersion = (uint32_t)read_value(&level->inputFile, 4);
+
+    if (level->importedData.fileVersion != 32)
+    {
+        set_level_error(level, DIG_ERROR_MALFORMED);
+    }
+
+    return;
+}
+
+/* Imports the level's data, seeking to each needed section by way of the level's
+ * table of contents. Stops at the first error in the data, which is recorded as
+ * the level's.*/
+void import_data_from_input_file(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    struct data_cursor_s *const inputFile = &level->inputFile;
+    const struct level_toc_s *const toc = &level->toc;
+    struct data_cursor_s meshData;    /* The raw mesh data array...*/
+    struct data_cursor_s meshOffsets; /* ...and each mesh's offset into it.*/
+    int i = 0, p = 0;
+
+    read_file_version(level);
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    /* Read textures.*/
+    stats_begin_phase(level, "textures");
+    read_texture_atlases(level);
+    stats_end_phase(level, (inputFile->pos - toc->sections[LEVEL_SECTION_TEXTURE_ATLASES].offset));
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    /* Read rooms. The table of contents says where each room's data are, so the
+     * selected rooms can be decoded in parallel.*/
+    {
+        const struct room_index_s *const roomIndex = toc->rooms;
+        struct room_decode_context_s context;
+        size_t roomDataSize = 0;
+        uint64_t numBytesRead = 0;
+
+        stats_begin_phase(level, "rooms");
+
+        select_rooms(level);
+
+        for (i = 0; i < importedData->numRoomMeshes; i++)
+        {
+            if (!importedData->roomIsSelected[i])
+            {
+                continue;
+            }
+
+            roomDataSize += vertex_buffer_arena_size(roomIndex[i].numVertices, 1);
+            roomDataSize += ARENA_ALIGNED_SIZE(sizeof(struct tr_quad_s) * roomIndex[i].numQuads);
+            roomDataSize += ARENA_ALIGNED_SIZE(sizeof(struct tr_triangle_s) * roomIndex[i].numTriangles);
+            roomDataSize += ARENA_ALIGNED_SIZE(sizeof(struct tr_mesh_meta_s) * roomIndex[i].numStaticObjects);
+
+            numBytesRead += ((roomIndex[i].numRoomDataWords * 2) + (roomIndex[i].numStaticObjects * SIZE_TR_ROOM_STATIC_MESH));
+            stats_count_faces(level, (roomIndex[i].numQuads + roomIndex[i].numTriangles));
+        }
+
+        arena_reserve(level->roomArena, roomDataSize);
+
+        context.level = level;
+        context.roomIndex = roomIndex;
+
+        run_parallel_tasks(importedData->numRoomMeshes, decode_room_task, &context, level->numThreads);
+
+        stats_end_phase(level, numBytesRead);
+    }
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    /* Read meshes. They're decoded once it's known which of them the selected
+     * rooms use.*/
+    {
+        struct weld_table_s staticMeshIds;
+        unsigned *meshIdxs = NULL;
+
+        stats_begin_phase(level, "meshes");
+
+        locate_meshes(level, &meshData, &meshOffsets);
+        meshIdxs = load_static_mesh_table(level, &staticMeshIds);
+
+        for (i = 0; i < importedData->numRoomMeshes; i++)
+        {
+            resolve_static_objects(level, i, &staticMeshIds, meshIdxs);
+
+            for (p = 0; p < importedData->roomMeshes[i].numStaticObjects; p++)
+            {
+                importedData->meshIsSelected[importedData->roomMeshes[i].staticObjects[p].meshIdx] = 1;
+            }
+        }
+
+        weld_table_free(&staticMeshIds);
+        free(meshIdxs);
+
+        decode_selected_meshes(level, &meshData, &meshOffsets);
+
+        stats_end_phase(level, (meshData.size + meshOffsets.size +
+                                (toc->sections[LEVEL_SECTION_STATIC_MESHES].count * SIZE_TR_STATIC_MESH)));
+    }
+
+    check_cursor(level, inputFile);
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    /* Move the static objects' vertices into place, unless the objects will be
+     * exported as instances of their meshes.*/
+    stats_begin_phase(level, "static object placement");
+    if (static_objects_need_placing(level))
+    {
+        run_parallel_tasks(importedData->numRoomMeshes, place_static_objects_task, level, level->numThreads);
+    }
+    stats_end_phase(level, 0);
+
+    /* Read object textures, and copy the selected ones' images out of the
+     * texture atlases.*/
+    {
+        stats_begin_phase(level, "object textures");
+
+        read_object_textures(level);
+
+        if (level_error(level) != DIG_OK)
+        {
+            return;
+        }
+
+        select_object_textures(level);
+
+        for (i = 0; i < importedData->numTextureImages; i++)
+        {
+            if (importedData->textureImageIsSelected[i])
+            {
+                copy_texture_image(level, &level->arena, i);
+            }
+        }
+
+        link_object_texture_pixels(level);
+
+        stats_end_phase(level, (importedData->numObjectTextures * SIZE_TR_OBJECT_TEXTURE));
+    }
+
+    if (level->repackTextures)
+    {
+        stats_begin_phase(level, "texture packing");
+
+        pack_texture_pages(level);
+        alloc_texture_pages(level, &level->arena);
+
+        for (i = 0; i < importedData->numTextureAtlases; i++)
+        {
+            draw_texture_pages(level, i);
+        }
+
+        stats_end_phase(level, 0);
+    }
+
+    stats_begin_phase(level, "palette");
+    read_palette(level);
+    stats_end_phase(level, 768);
+
+    return;
+}
+
+/* Selects for export the meshes that the given room's static objects use,
+ * reading the objects' mesh IDs straight from the level file rather than
+ * decoding the room.*/
+void select_room_static_meshes(struct level_s *const level,
+                               const unsigned roomIdx,
+                               const struct weld_table_s *const staticMeshIds,
+                               const unsigned *const meshIdxs)
+{
+    const struct room_index_s *const index = &level->toc.rooms[roomIdx];
+    struct data_cursor_s staticObjectData = level->inputFile;
+    unsigned p = 0;
+
+    seek_to(&staticObjectData, index->staticObjectsOffset);
+
+    for (p = 0; p < index->numStaticObjects; p++)
+    {
+        unsigned meshIdx = 0;
+
+        skip_num_bytes(&staticObjectData, 16); /* Skip the position, rotation and lighting.*/
+        meshIdx = find_static_mesh(level, staticMeshIds, meshIdxs, read_value(&staticObjectData, 2));
+
+        if (meshIdx != WELD_TABLE_NOT_FOUND)
+        {
+            level->importedData.meshIsSelected[meshIdx] = 1;
+        }
+    }
+
+    check_cursor(level, &staticObjectData);
+
+    return;
+}
+
+/* Imports, in streaming mode, only the level's data that all of its rooms and
+ * object textures need for their export: the texture atlases (as they are in
+ * the level file), the meshes used by the selected rooms' static objects, the
+ * object textures' metadata and the palette. The rooms' geometry and the object
+ * textures' pixels are instead decoded as they're exported.*/
+void import_streaming_data_from_input_file(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    const struct level_toc_s *const toc = &level->toc;
+    unsigned i = 0;
+
+    read_file_version(level);
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    stats_begin_phase(level, "textures");
+    read_texture_atlases(level);
+    stats_end_phase(level, 0);
+
+    stats_begin_phase(level, "meshes");
+    {
+        struct data_cursor_s meshData;
+        struct data_cursor_s meshOffsets;
+        struct weld_table_s staticMeshIds;
+        unsigned *meshIdxs = NULL;
+        size_t releasedEnd = 0;
+
+        select_rooms(level);
+        locate_meshes(level, &meshData, &meshOffsets);
+        meshIdxs = load_static_mesh_table(level, &staticMeshIds);
+
+        for (i = 0; i < importedData->numRoomMeshes; i++)
+        {
+            if (importedData->roomIsSelected[i])
+            {
+                select_room_static_meshes(level, i, &staticMeshIds, meshIdxs);
+                release_input_behind(level, &releasedEnd, toc->rooms[i].staticObjectsOffset);
+            }
+        }
+
+        weld_table_free(&staticMeshIds);
+        free(meshIdxs);
+
+        decode_selected_meshes(level, &meshData, &meshOffsets);
+        release_input_range(level, toc->sections[LEVEL_SECTION_MESH_DATA].offset, meshData.size);
+
+        stats_end_phase(level, (meshData.size + meshOffsets.size +
+                                (toc->sections[LEVEL_SECTION_STATIC_MESHES].count * SIZE_TR_STATIC_MESH)));
+    }
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    stats_begin_phase(level, "object textures");
+    read_object_textures(level);
+    if (level_error(level) == DIG_OK)
+    {
+        select_object_textures(level);
+    }
+    stats_end_phase(level, (importedData->numObjectTextures * SIZE_TR_OBJECT_TEXTURE));
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    /* The pages are drawn as the atlases are streamed.*/
+    if (level->repackTextures)
+    {
+        stats_begin_phase(level, "texture packing");
+        pack_texture_pages(level);
+        stats_end_phase(level, 0);
+    }
+
+    stats_begin_phase(level, "palette");
+    read_palette(level);
+    stats_end_phase(level, 768);
+
+    return;
+}
+
+void byte_buffer_reserve(struct byte_buffer_s *const buffer, const size_t numBytes)
+{
+    if ((buffer->size + numBytes) > buffer->capacity)
+    {
+        buffer->capacity = ((buffer->capacity * 2) > (buffer->size + numBytes))? (buffer->capacity * 2)
+                                                                               : (buffer->size + numBytes);
+        buffer->data = realloc(buffer->data, buffer->capacity);
+
+        assert(buffer->data && "Failed to allocate memory for a byte buffer.");
+    }
+
+    return;
+}
+
+void byte_buffer_append(struct byte_buffer_s *const buffer, const void *const src, const size_t numBytes)
+{
+    /* E.g. PNG's IEND chunk has no data, and passes NULL as its source.*/
+    if (!numBytes)
+    {
+        return;
+    }
+
+    byte_buffer_reserve(buffer, numBytes);
+    memcpy((buffer->data + buffer->size), src, numBytes);
+    buffer->size += numBytes;
+
+    return;
+}
+
+void byte_buffer_put_byte(struct byte_buffer_s *const buffer, const uint8_t value)
+{
+    byte_buffer_reserve(buffer, 1);
+    buffer->data[buffer->size++] = value;
+
+    return;
+}
+
+void byte_buffer_put_be32(struct byte_buffer_s *const buffer, const uint32_t value)
+{
+    byte_buffer_put_byte(buffer, ((value >> 24) & 0xff));
+    byte_buffer_put_byte(buffer, ((value >> 16) & 0xff));
+    byte_buffer_put_byte(buffer, ((value >> 8) & 0xff));
+    byte_buffer_put_byte(buffer, (value & 0xff));
+
+    return;
+}
+
+/* Appends the given printf-style formatted text, without a null terminator.*/
+void byte_buffer_printf(struct byte_buffer_s *const buffer, const char *const format, ...)
+{
+    va_list args;
+    int length = 0;
+
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    assert((length >= 0) && "Failed to format text.");
+
+    /* Leave room for the null terminator that vsnprintf() writes.*/
+    byte_buffer_reserve(buffer, (length + 1));
+
+    va_start(args, format);
+    vsnprintf((char*)(buffer->data + buffer->size), (length + 1), format, args);
+    va_end(args);
+
+    buffer->size += length;
+
+    return;
+}
+
+void byte_buffer_free(struct byte_buffer_s *const buffer)
+{
+    free(buffer->data);
+
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+
+    return;
+}
+
+void manifest_init(struct output_manifest_s *const manifest)
+{
+    pthread_mutex_init(&manifest->lock, NULL);
+    manifest->numEntries = 0;
+    manifest->capacity = 0;
+    manifest->entries = NULL;
+    weld_table_init(&manifest->pathHashes, 2, 256);
+
+    return;
+}
+
+void manifest_free(struct output_manifest_s *const manifest)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < manifest->numEntries; i++)
+    {
+        free(manifest->entries[i].path);
+    }
+
+    free(manifest->entries);
+    weld_table_free(&manifest->pathHashes);
+    pthread_mutex_destroy(&manifest->lock);
+
+    return;
+}
+
+/* Returns the manifest's entry for the given path, adding one if there isn't
+ * any. Call with the manifest locked.*/
+struct manifest_entry_s* manifest_entry(struct output_manifest_s *const manifest, const char *const path)
+{
+    const uint64_t pathHash = hash_bytes((const uint8_t*)path, strlen(path));
+    uint32_t key[2];
+    unsigned entryIdx = 0;
+
+    key[0] = (uint32_t)pathHash;
+    key[1] = (uint32_t)(pathHash >> 32);
+    entryIdx = weld_table_insert(&manifest->pathHashes, key);
+
+    if (entryIdx == manifest->numEntries)
+    {
+        struct manifest_entry_s *entry = NULL;
+
+        if (manifest->numEntries == manifest->capacity)
+        {
+            manifest->capacity = (manifest->capacity? (manifest->capacity * 2) : 256);
+            manifest->entries = realloc(manifest->entries, (sizeof(struct manifest_entry_s) * manifest->capacity));
+            assert(manifest->entries && "Failed to allocate memory for the manifest.");
+        }
+
+        entry = &manifest->entries[manifest->numEntries++];
+        entry->path = strdup(path);
+        entry->hash = 0;
+        entry->size = 0;
+        entry->status = OUTPUT_NOT_EXPORTED;
+        assert(entry->path && "Failed to allocate memory for the manifest.");
+    }
+
+    return &manifest->entries[entryIdx];
+}
+
+/* Loads the manifest saved into the level's output directory on the previous
+ * run, if there is one. Each of its lines gives a file's content hash (in hex),
+ * its size, and its path relative to the output directory.*/
+void load_manifest(const struct level_s *const level)
+{
+    struct output_manifest_s *const manifest = level->manifest;
+    char filename[MAX_PATH_LENGTH];
+    char line[MAX_PATH_LENGTH + 64];
+    FILE *inFile = NULL;
+
+    make_output_filename(filename, level, MANIFEST_FILENAME);
+
+    if (!(inFile = fopen(filename, "rb")))
+    {
+        return;
+    }
+
+    while (fgets(line, sizeof(line), inFile))
+    {
+        char *end = NULL;
+        const uint64_t hash = strtoull(line, &end, 16);
+        const uint64_t size = strtoull(end, &end, 10);
+        char *const path = ((*end == ' ')? (end + 1) : NULL);
+
+        if (!path || !*path)
+        {
+            continue;
+        }
+
+        path[strcspn(path, "\n")] = '\0';
+
+        {
+            struct manifest_entry_s *const entry = manifest_entry(manifest, path);
+
+            entry->hash = hash;
+            entry->size = size;
+        }
+    }
+
+    fclose(inFile);
+
+    return;
+}
+
+/* Records the given contents for the given output file in the level's manifest.
+ * Returns true if the file needs to be written, i.e. if its contents differ
+ * from those listed or it has since gone missing.*/
+int update_manifest(const struct level_s *const level,
+                    const char *const filename,
+                    const uint64_t hash,
+                    const size_t numBytes)
+{
+    struct output_manifest_s *const manifest = level->manifest;
+    const char *const path = (filename + strlen(level->outputPath));
+    struct manifest_entry_s *entry = NULL;
+    struct stat fileInfo;
+    int isUnchanged = 0;
+
+    assert((strncmp(filename, level->outputPath, strlen(level->outputPath)) == 0) &&
+           "Output file outside of the level's output directory.");
+
+    isUnchanged = ((stat(filename, &fileInfo) == 0) && ((uint64_t)fileInfo.st_size == numBytes));
+
+    pthread_mutex_lock(&manifest->lock);
+
+    entry = manifest_entry(manifest, path);
+    isUnchanged = (isUnchanged && (entry->hash == hash) && (entry->size == numBytes) &&
+                   (entry->status == OUTPUT_NOT_EXPORTED));
+
+    entry->status = (isUnchanged? OUTPUT_UNCHANGED : (entry->size || entry->hash)? OUTPUT_CHANGED : OUTPUT_ADDED);
+    entry->hash = hash;
+    entry->size = numBytes;
+
+    pthread_mutex_unlock(&manifest->lock);
+
+    return !isUnchanged;
+}
+
+/* Saves the given bytes into the given output file; or in incremental mode, only
+ * if they differ from the file's contents on the previous run.*/
+void save_output_file(const struct level_s *const level,
+                      const char *const filename,
+                      const void *const data,
+                      const size_t numBytes)
+{
+    FILE *outFile = NULL;
+    size_t numWritten = 0;
+
+    if (level->manifest &&
+        !update_manifest(level, filename, hash_bytes(data, numBytes), numBytes))
+    {
+        return;
+    }
+
+    if (!(outFile = fopen(filename, "wb")))
+    {
+        set_level_error(level, DIG_ERROR_OUTPUT);
+        return;
+    }
+
+    numWritten = fwrite(data, 1, numBytes, outFile);
+
+    if ((fclose(outFile) != 0) || (numWritten != numBytes))
+    {
+        set_level_error(level, DIG_ERROR_OUTPUT);
+        return;
+    }
+
+    stats_count_output_file(level, numBytes);
+
+    return;
+}
+
+void writer_open(struct output_writer_s *const writer,
+                 const struct level_s *const level,
+                 const char *const filename,
+                 char *const buffer,
+                 const size_t bufferSize)
+{
+    assert((bufferSize >= 64) && "The output buffer is too small.");
+    assert((strlen(filename) < sizeof(writer->filename)) && "Output path is too long.");
+
+    writer->level = level;
+    strcpy(writer->filename, filename);
+
+    writer->file = NULL;
+    memset(&writer->contents, 0, sizeof(writer->contents));
+    writer->numBytesWritten = 0;
+    writer->failed = 0;
+
+    if (!level->manifest &&
+        !(writer->file = fopen(filename, "wb")))
+    {
+        set_level_error(level, DIG_ERROR_OUTPUT);
+        writer->failed = 1;
+    }
+
+    writer->buffer = buffer;
+    writer->bufferSize = bufferSize;
+    writer->used = 0;
+
+    return;
+}
+
+/* Passes the given bytes on to the writer's file, or in incremental mode, to its
+ * in-memory copy of the file.*/
+void writer_output(struct output_writer_s *const writer, const void *const data, const size_t numBytes)
+{
+    if (writer->failed)
+    {
+        return;
+    }
+    else if (writer->file)
+    {
+        const size_t numWritten = fwrite(data, 1, numBytes, writer->file);
+
+        if (numWritten != numBytes)
+        {
+            set_level_error(writer->level, DIG_ERROR_OUTPUT);
+            writer->failed = 1;
+        }
+
+        writer->numBytesWritten += numWritten;
+    }
+    else
+    {
+        byte_buffer_append(&writer->contents, data, numBytes);
+    }
+
+    return;
+}
+
+void writer_flush(struct output_writer_s *const writer)
+{
+    if (writer->used)
+    {
+        writer_output(writer, writer->buffer, writer->used);
+        writer->used = 0;
+    }
+
+    return;
+}
+
+void writer_close(struct output_writer_s *const writer)
+{
+    writer_flush(writer);
+
+    if (writer->file)
+    {
+        if ((fclose(writer->file) != 0) && !writer->failed)
+        {
+            set_level_error(writer->level, DIG_ERROR_OUTPUT);
+            writer->failed = 1;
+        }
+
+        writer->file = NULL;
+
+        if (!writer->failed)
+        {
+            stats_count_output_file(writer->level, writer->numBytesWritten);
+        }
+    }
+    else if (!writer->failed)
+    {
+        save_output_file(writer->level, writer->filename, writer->contents.data, writer->contents.size);
+        byte_buffer_free(&writer->contents);
+    }
+
+    return;
+}
+
+/* Returns a pointer to at least the given number of free bytes at the end of the
+ * writer's buffer, flushing the buffer first if need be.*/
+char* writer_reserve(struct output_writer_s *const writer, const size_t numBytes)
+{
+    if ((writer->bufferSize - writer->used) < numBytes)
+    {
+        writer_flush(writer);
+    }
+
+    return (writer->buffer + writer->used);
+}
+
+void write_bytes(struct output_writer_s *const writer, const void *const data, const size_t numBytes)
+{
+    if (numBytes > writer->bufferSize)
+    {
+        writer_flush(writer);
+        writer_output(writer, data, numBytes);
+    }
+    else
+    {
+        memcpy(writer_reserve(writer, numBytes), data, numBytes);
+        writer->used += numBytes;
+    }
+
+    return;
+}
+
+void write_string(struct output_writer_s *const writer, const char *const string)
+{
+    write_bytes(writer, string, strlen(string));
+
+    return;
+}
+
+void write_char(struct output_writer_s *const writer, const char c)
+{
+    *writer_reserve(writer, 1) = c;
+    writer->used++;
+
+    return;
+}
+
+/* Writes the given number's decimal digits into the end of the given buffer, and
+ * returns a pointer to the first of them.*/
+char* format_digits(char *const bufferEnd, uint64_t value)
+{
+    char *digits = bufferEnd;
+
+    do
+    {
+        *--digits = ('0' + (value % 10));
+        value /= 10;
+    } while (value);
+
+    return digits;
+}
+
+void write_uint(struct output_writer_s *const writer, const uint64_t value)
+{
+    char tmp[24];
+    const char *const digits = format_digits((tmp + sizeof(tmp)), value);
+
+    write_bytes(writer, digits, ((tmp + sizeof(tmp)) - digits));
+
+    return;
+}
+
+/* Writes the given integer as printf's "%d" would.*/
+void write_int(struct output_writer_s *const writer, const int64_t value)
+{
+    if (value < 0)
+    {
+        write_char(writer, '-');
+        write_uint(writer, (0 - (uint64_t)value));
+    }
+    else
+    {
+        write_uint(writer, value);
+    }
+
+    return;
+}
+
+/* Writes the given value as printf's "%f" would, with six decimals. The value is
+ * split into its binary mantissa and exponent and rounded exactly (ties to even)
+ * in integer arithmetic, so the output matches the C library's digit for digit.
+ * Values whose mantissa is too wide for that (none of TR's floats are; they come
+ * from 16-bit fixed-point) or that aren't finite are handed to snprintf().*/
+void write_float(struct output_writer_s *const writer, const double value)
+{
+    uint64_t bits = 0;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    uint64_t scaled = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    exponent = ((bits >> 52) & 0x7ff);
+    mantissa = (bits & 0xfffffffffffffULL);
+
+    if (exponent == 0) /* Zero or subnormal; either way, rounds to 0.*/
+    {
+        mantissa = 0;
+    }
+    else
+    {
+        mantissa |= (1ULL << 52);
+        exponent -= (1023 + 52);
+    }
+
+    while (mantissa && !(mantissa & 1))
+    {
+        mantissa >>= 1;
+        exponent++;
+    }
+
+    /* The value is now mantissa * 2^exponent, which can be scaled by 10^6 within
+     * 64 bits only if the mantissa is narrow enough.*/
+    if ((((bits >> 52) & 0x7ff) == 0x7ff) ||
+        (mantissa >= (1ULL << 44)) ||
+        ((exponent > 0) && ((exponent >= 44) || (mantissa >= (1ULL << (44 - exponent))))))
+    {
+        char tmp[512];
+        const int length = snprintf(tmp, sizeof(tmp), "%f", value);
+
+        assert(((length > 0) && ((size_t)length < sizeof(tmp))) && "Failed to format a number.");
+        write_bytes(writer, tmp, length);
+
+        return;
+    }
+
+    if (exponent >= 0)
+    {
+        scaled = ((mantissa << exponent) * 1000000);
+    }
+    else if (exponent > -64)
+    {
+        const unsigned shift = -exponent;
+        const uint64_t product = (mantissa * 1000000);
+        const uint64_t remainder = (product & ((1ULL << shift) - 1));
+        const uint64_t half = (1ULL << (shift - 1));
+
+        scaled = (product >> shift);
+
+        if ((remainder > half) ||
+            ((remainder == half) && (scaled & 1)))
+        {
+            scaled++;
+        }
+    }
+    else if (exponent == -64)
+    {
+        /* Less than one millionth, but rounds up to it if over half of it.*/
+        scaled = ((mantissa * 1000000) > (1ULL << 63));
+    }
+
+    {
+        char tmp[32];
+        char *const end = (tmp + sizeof(tmp));
+        char *digits = format_digits(end, scaled);
+        unsigned numDigits = (end - digits);
+
+        /* Pad to at least one integer digit plus the six decimals.*/
+        while (numDigits < 7)
+        {
+            *--digits = '0';
+            numDigits++;
+        }
+
+        if (bits >> 63)
+        {
+            write_char(writer, '-');
+        }
+
+        write_bytes(writer, digits, (numDigits - 6));
+        write_char(writer, '.');
+        write_bytes(writer, (end - 6), 6);
+    }
+
+    return;
+}
+
+int compare_manifest_entries(const void *const a, const void *const b)
+{
+    return strcmp(((const struct manifest_entry_s*)a)->path, ((const struct manifest_entry_s*)b)->path);
+}
+
+/* Prints out which files were added or changed on this run, and saves the level's
+ * updated manifest if any were. Files exported on earlier runs but not on this
+ * one (e.g. because only some of the rooms were selected) stay listed.*/
+void save_manifest(const struct level_s *const level)
+{
+    struct output_manifest_s *const manifest = level->manifest;
+    unsigned numChanged = 0, numAdded = 0, numUnchanged = 0;
+    unsigned i = 0;
+
+    /* The entries' order depends on the order in which threads exported them.*/
+    qsort(manifest->entries, manifest->numEntries, sizeof(struct manifest_entry_s), compare_manifest_entries);
+
+    for (i = 0; i < manifest->numEntries; i++)
+    {
+        const struct manifest_entry_s *const entry = &manifest->entries[i];
+
+        switch (entry->status)
+        {
+            case OUTPUT_UNCHANGED: numUnchanged++; break;
+            case OUTPUT_CHANGED: numChanged++; printf("  Changed: %s%s\n", level->outputPath, entry->path); break;
+            case OUTPUT_ADDED: numAdded++; printf("  Added: %s%s\n", level->outputPath, entry->path); break;
+            default: break;
+        }
+    }
+
+    printf("%s: %u files changed, %u added, %u unchanged.\n",
+           level->inputFilename, numChanged, numAdded, numUnchanged);
+
+    if (numChanged || numAdded)
+    {
+        char filename[MAX_PATH_LENGTH];
+        char outputBuffer[OUTPUT_BUFFER_SIZE];
+        struct output_writer_s outFile;
+        struct level_s manifestLevel = *level;
+
+        /* The manifest itself isn't listed in the manifest.*/
+        manifestLevel.manifest = NULL;
+
+        make_output_filename(filename, level, MANIFEST_FILENAME);
+        writer_open(&outFile, &manifestLevel, filename, outputBuffer, sizeof(outputBuffer));
+
+        for (i = 0; i < manifest->numEntries; i++)
+        {
+            const struct manifest_entry_s *const entry = &manifest->entries[i];
+            char hash[17];
+
+            snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)entry->hash);
+            write_string(&outFile, hash);
+            write_char(&outFile, ' ');
+            write_uint(&outFile, entry->size);
+            write_char(&outFile, ' ');
+            write_string(&outFile, entry->path);
+            write_char(&outFile, '\n');
+        }
+
+        writer_close(&outFile);
+    }
+
+    return;
+}
+
+/* Returns the texture index with which a textured face using the given object
+ * texture is exported: the object texture's own, or if the textures have been
+ * repacked, that of the texture page its image is on.*/
+int face_texture_idx(const struct imported_data_s *const importedData, const int textureIdx)
+{
+    if ((textureIdx >= 0) &&
+        ((unsigned)textureIdx < importedData->numObjectTextures))
+    {
+        const unsigned pageIdx = importedData->textureImages[importedData->objectTextures[textureIdx].imageIdx].pageIdx;
+
+        if (pageIdx != TEXTURE_PAGE_NONE)
+        {
+            return pageIdx;
+        }
+    }
+
+    return textureIdx;
+}
+
+/* Returns a newly allocated list of the faces of the given room (unless it's
+ * NULL) followed by those of the given static objects, whose vertices must have
+ * been placed, in the same order as they're written into .trm files.*/
+struct export_face_s* collect_faces(const struct imported_data_s *const importedData,
+                                    const struct tr_room_mesh_s *const room,
+                                    const struct tr_mesh_meta_s *const objects,
+                                    const unsigned numObjects,
+                                    unsigned *const numFaces)
+{
+    struct export_face_s *faces = NULL;
+    unsigned faceIdx = 0;
+    unsigned i = 0, j = 0;
+
+    *numFaces = (room? (room->numQuads + room->numTriangles) : 0);
+
+    for (i = 0; i < numObjects; i++)
+    {
+        *numFaces += mesh_num_faces(&importedData->meshes[objects[i].meshIdx]);
+    }
+
+    faces = malloc(sizeof(struct export_face_s) * (*numFaces ? *numFaces : 1));
+    assert(faces && "Failed to allocate memory for a room's faces.");
+
+    /* Copies the given faces into the list.*/
+    #define COLLECT_FACES(numSrcFaces, srcFaces, vertices, numVertsPerFace, facesAreTextured)\
+            for (j = 0; j < numSrcFaces; j++)\
+            {\
+                struct export_face_s *const face = &faces[faceIdx++];\
+                const struct tr_object_texture_s *const texture = ((srcFaces[j].textureIdx < importedData->numObjectTextures)?\
+                                                                   &importedData->objectTextures[srcFaces[j].textureIdx]\
+                                                                   : NULL);\
+                unsigned v = 0;\
+                \
+                face->numVertices = numVertsPerFace;\
+                face->textureIdx = (facesAreTextured? face_texture_idx(importedData, srcFaces[j].textureIdx)\
+                                                    : -(srcFaces[j].textureIdx & 0xff));\
+                \
+                for (v = 0; v < numVertsPerFace; v++)\
+                {\
+                    const unsigned vertexIdx = srcFaces[j].vertexIdx[v];\
+                    \
+                    face->x[v] = (vertices)->x[vertexIdx];\
+                    face->y[v] = (vertices)->y[vertexIdx];\
+                    face->z[v] = (vertices)->z[vertexIdx];\
+                    face->u[v] = (texture? texture->u[v] : 0);\
+                    face->v[v] = (texture? texture->v[v] : 0);\
+                    face->lighting[v] = ((vertices)->lighting? (vertices)->lighting[vertexIdx] : 0);\
+                }\
+            }
+
+    if (room)
+    {
+        COLLECT_FACES(room->numQuads, room->quads, &room->vertices, 4, 1);
+        COLLECT_FACES(room->numTriangles, room->triangles, &room->vertices, 3, 1);
+    }
+
+    for (i = 0; i < numObjects; i++)
+    {
+        const struct tr_mesh_meta_s *const objectMeta = &objects[i];
+        const struct tr_mesh_s *const object = &importedData->meshes[objectMeta->meshIdx];
+
+        COLLECT_FACES(object->numTexturedQuads, object->texturedQuads, &objectMeta->vertices, 4, 1);
+        COLLECT_FACES(object->numTexturedTriangles, object->texturedTriangles, &objectMeta->vertices, 3, 1);
+        COLLECT_FACES(object->numUntexturedQuads, object->untexturedQuads, &objectMeta->vertices, 4, 0);
+        COLLECT_FACES(object->numUntexturedTriangles, object->untexturedTriangles, &objectMeta->vertices, 3, 0);
+    }
+
+    #undef COLLECT_FACES
+
+    return faces;
+}
+
+/* Returns a newly allocated list of the given room's faces, including those of
+ * its static objects unless they're exported as instances.*/
+struct export_face_s* collect_room_faces(const struct level_s *const level,
+                                         const unsigned roomIdx,
+                                         unsigned *const numFaces)
+{
+    const struct tr_room_mesh_s *const room = &level->importedData.roomMeshes[roomIdx];
+
+    return collect_faces(&level->importedData, room,
+                         room->staticObjects,
+                         (level->instancedStatics? 0 : room->numStaticObjects),
+                         numFaces);
+}
+
+/* Returns a newly allocated list of the faces of the given mesh of the master
+ * list, in the mesh's own coordinates.*/
+struct export_face_s* collect_object_mesh_faces(const struct imported_data_s *const importedData,
+                                                const unsigned meshIdx,
+                                                unsigned *const numFaces)
+{
+    struct tr_mesh_meta_s placement;
+
+    memset(&placement, 0, sizeof(placement));
+    placement.meshIdx = meshIdx;
+    placement.vertices = importedData->meshes[meshIdx].vertices;
+
+    return collect_faces(importedData, NULL, &placement, 1, numFaces);
+}
+
+void put_le32(uint8_t *const dst, const uint32_t value)
+{
+    dst[0] = (value & 0xff);
+    dst[1] = ((value >> 8) & 0xff);
+    dst[2] = ((value >> 16) & 0xff);
+    dst[3] = ((value >> 24) & 0xff);
+
+    return;
+}
+
+void write_le32(struct output_writer_s *const writer, const uint32_t value)
+{
+    uint8_t bytes[4];
+
+    put_le32(bytes, value);
+    write_bytes(writer, bytes, sizeof(bytes));
+
+    return;
+}
+
+/* Saves the given faces as a .trb file into the given directory of the output,
+ * named after the given room or mesh index.
+ *
+ * A .trb file consists of little-endian 32-bit values, so that it can be
+ * memory-mapped and used as is:
+ *
+ *   header           "TRB1", numVertices, numUVs, numFaces, and the byte
+ *                    offsets of the five arrays below
+ *   vertices         int32 x, y, z per vertex
+ *   UVs              float u, v per UV coordinate
+ *   face vertices    uint32 vertex index x 4 per face
+ *   face UVs         uint32 UV index x 4 per face
+ *   face textures    int32 per face, as the texture index in .trm files
+ *
+ * Triangles have 0xffffffff as their fourth vertex and UV index.*/
+void save_mesh_trb(const struct level_s *const level,
+                   const char *const directory,
+                   const unsigned meshIdx,
+                   const struct export_face_s *const faces,
+                   const unsigned numFaces)
+{
+    const unsigned headerNumWords = 9;
+    struct weld_table_s vertices, uvs;
+    uint32_t *faceIndices = NULL; /* Vertex indices followed by UV indices.*/
+    unsigned i = 0, v = 0;
+
+    weld_table_init(&vertices, 3, (numFaces * 2));
+    weld_table_init(&uvs, 2, numFaces);
+
+    faceIndices = malloc(sizeof(uint32_t) * 8 * (numFaces? numFaces : 1));
+    assert(faceIndices && "Failed to allocate memory for a room's face indices.");
+
+    for (i = 0; i < numFaces; i++)
+    {
+        for (v = 0; v < 4; v++)
+        {
+            uint32_t *const vertexIdx = &faceIndices[(i * 4) + v];
+            uint32_t *const uvIdx = &faceIndices[((numFaces + i) * 4) + v];
+
+            if (v < faces[i].numVertices)
+            {
+                uint32_t vertexKey[3];
+                uint32_t uvKey[2];
+
+                vertexKey[0] = faces[i].x[v];
+                vertexKey[1] = faces[i].y[v];
+                vertexKey[2] = faces[i].z[v];
+                memcpy(&uvKey[0], &faces[i].u[v], sizeof(float));
+                memcpy(&uvKey[1], &faces[i].v[v], sizeof(float));
+
+                *vertexIdx = weld_table_insert(&vertices, vertexKey);
+                *uvIdx = weld_table_insert(&uvs, uvKey);
+            }
+            else
+            {
+                *vertexIdx = ~0u;
+                *uvIdx = ~0u;
+            }
+        }
+    }
+
+    /* Write the file.*/
+    {
+        const unsigned numVertexWords = (vertices.numKeys * 3);
+        const unsigned numUVWords = (uvs.numKeys * 2);
+        const size_t numWords = (headerNumWords + numVertexWords + numUVWords + (numFaces * 9));
+        uint8_t *const fileData = malloc(sizeof(uint32_t) * numWords);
+        uint8_t *dst = fileData;
+        char filename[MAX_PATH_LENGTH];
+
+        assert(fileData && "Failed to allocate memory for exporting a mesh.");
+
+        #define PUT_WORD(value) put_le32(dst, (value)); dst += sizeof(uint32_t);
+
+        memcpy(dst, "TRB1", 4);
+        dst += 4;
+        PUT_WORD(vertices.numKeys);
+        PUT_WORD(uvs.numKeys);
+        PUT_WORD(numFaces);
+        PUT_WORD(sizeof(uint32_t) * headerNumWords);
+        PUT_WORD(sizeof(uint32_t) * (headerNumWords + numVertexWords));
+        PUT_WORD(sizeof(uint32_t) * (headerNumWords + numVertexWords + numUVWords));
+        PUT_WORD(sizeof(uint32_t) * (headerNumWords + numVertexWords + numUVWords + (numFaces * 4)));
+        PUT_WORD(sizeof(uint32_t) * (headerNumWords + numVertexWords + numUVWords + (numFaces * 8)));
+
+        for (i = 0; i < numVertexWords; i++)
+        {
+            PUT_WORD(vertices.keys[i]);
+        }
+
+        for (i = 0; i < numUVWords; i++)
+        {
+            PUT_WORD(uvs.keys[i]);
+        }
+
+        for (i = 0; i < (numFaces * 8); i++)
+        {
+            PUT_WORD(faceIndices[i]);
+        }
+
+        for (i = 0; i < numFaces; i++)
+        {
+            PUT_WORD(faces[i].textureIdx);
+        }
+
+        #undef PUT_WORD
+
+        make_output_filename(filename, level, "%s%u.trb", directory, meshIdx);
+        save_output_file(level, filename, fileData, (dst - fileData));
+
+        free(fileData);
+    }
+
+    weld_table_free(&vertices);
+    weld_table_free(&uvs);
+    free(faceIndices);
+
+    return;
+}
+
+/* Saves the given faces as a Wavefront .obj file and an accompanying .mtl
+ * material library into the given directory of the output, named after the
+ * given room or mesh index. The output matches what trm2obj.php produces from
+ * the corresponding .trm file; the object textures are expected as .png files
+ * in texture/object/. With repacked textures, each texture page is a material
+ * of its own instead, expected in texture/page/.*/
+void save_mesh_obj(const struct level_s *const level,
+                   const char *const directory,
+                   const unsigned meshIdx,
+                   const struct export_face_s *const faces,
+                   const unsigned numFaces)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    struct weld_table_s vertices, uvs, materials;
+    uint32_t *faceIndices = NULL; /* Each face's vertex and UV indices, interleaved.*/
+    unsigned i = 0, v = 0;
+    struct output_writer_s objFile, mtlFile;
+    char objBuffer[OUTPUT_BUFFER_SIZE], mtlBuffer[OUTPUT_BUFFER_SIZE];
+    char filename[MAX_PATH_LENGTH];
+
+    weld_table_init(&vertices, 3, (numFaces * 2));
+    weld_table_init(&uvs, 2, numFaces);
+    weld_table_init(&materials, 1, 64);
+
+    faceIndices = malloc(sizeof(uint32_t) * 8 * (numFaces? numFaces : 1));
+    assert(faceIndices && "Failed to allocate memory for a room's face indices.");
+
+    make_output_filename(filename, level, "%s%u.obj", directory, meshIdx);
+    writer_open(&objFile, level, filename, objBuffer, sizeof(objBuffer));
+
+    make_output_filename(filename, level, "%s%u.mtl", directory, meshIdx);
+    writer_open(&mtlFile, level, filename, mtlBuffer, sizeof(mtlBuffer));
+
+    /* Weld the vertices and UVs, and save the materials in order of first use.*/
+    for (i = 0; i < numFaces; i++)
+    {
+        const uint32_t materialKey = faces[i].textureIdx;
+        const unsigned numMaterials = materials.numKeys;
+
+        for (v = 0; v < faces[i].numVertices; v++)
+        {
+            uint32_t vertexKey[3];
+            uint32_t uvKey[2];
+
+            vertexKey[0] = faces[i].x[v];
+            vertexKey[1] = faces[i].y[v];
+            vertexKey[2] = faces[i].z[v];
+            memcpy(&uvKey[0], &faces[i].u[v], sizeof(float));
+            memcpy(&uvKey[1], &faces[i].v[v], sizeof(float));
+
+            faceIndices[(i * 8) + (v * 2) + 0] = weld_table_insert(&vertices, vertexKey);
+            faceIndices[(i * 8) + (v * 2) + 1] = weld_table_insert(&uvs, uvKey);
+        }
+
+        weld_table_insert(&materials, &materialKey);
+
+        if (materials.numKeys != numMaterials)
+        {
+            if (faces[i].textureIdx >= 0)
+            {
+                write_string(&mtlFile, (level->repackTextures? "newmtl texture_page_" : "newmtl object_texture_"));
+                write_int(&mtlFile, faces[i].textureIdx);
+                write_string(&mtlFile, "\nKd 1 1 1\n"
+                                       "Ks 0 0 0\n"
+                                       "Ns 0\n"
+                                       "illum 0\n");
+                if (level->repackTextures)
+                {
+                    write_string(&mtlFile, "map_Kd ../../texture/page/");
+                    write_int(&mtlFile, faces[i].textureIdx);
+                }
+                else if (level->dedupTextures)
+                {
+                    write_string(&mtlFile, "map_Kd ../../texture/image/");
+                    write_uint(&mtlFile, importedData->objectTextures[faces[i].textureIdx].imageIdx);
+                }
+                else
+                {
+                    write_string(&mtlFile, "map_Kd ../../texture/object/");
+                    write_int(&mtlFile, faces[i].textureIdx);
+                }
+                write_string(&mtlFile, ".png\n");
+            }
+            else
+            {
+                const uint8_t *const color = &importedData->palette[-faces[i].textureIdx * 3];
+
+                unsigned c = 0;
+
+                write_string(&mtlFile, "newmtl object_color_");
+                write_int(&mtlFile, -faces[i].textureIdx);
+                write_string(&mtlFile, "\nKd");
+                for (c = 0; c < 3; c++)
+                {
+                    write_char(&mtlFile, ' ');
+                    write_float(&mtlFile, (color[c] / 255.0));
+                }
+                write_string(&mtlFile, "\nKs 0 0 0\n"
+                                       "Ns 0\n"
+                                       "illum 0\n");
+            }
+
+            /* Separate the next material block from the current one.*/
+            write_char(&mtlFile, '\n');
+        }
+    }
+
+    write_string(&objFile, "# A conversion produced by dig/trm2obj of a Tomb Raider 1 mesh.\n"
+                           "mtllib ");
+    write_uint(&objFile, meshIdx);
+    write_string(&objFile, ".mtl\n"
+                           "o tr_mesh\n");
+
+    for (i = 0; i < vertices.numKeys; i++)
+    {
+        const int32_t *const vertex = (int32_t*)&vertices.keys[i * 3];
+
+        write_char(&objFile, 'v');
+        for (v = 0; v < 3; v++)
+        {
+            write_char(&objFile, ' ');
+            write_int(&objFile, vertex[v]);
+        }
+        write_char(&objFile, '\n');
+    }
+
+    for (i = 0; i < uvs.numKeys; i++)
+    {
+        float uv[2];
+
+        memcpy(uv, &uvs.keys[i * 2], sizeof(uv));
+        write_string(&objFile, "vt ");
+        write_float(&objFile, uv[0]);
+        write_char(&objFile, ' ');
+        write_float(&objFile, uv[1]);
+        write_char(&objFile, '\n');
+    }
+
+    for (i = 0; i < numFaces; i++)
+    {
+        if (faces[i].textureIdx >= 0)
+        {
+            write_string(&objFile, (level->repackTextures? "usemtl texture_page_" : "usemtl object_texture_"));
+            write_int(&objFile, faces[i].textureIdx);
+        }
+        else
+        {
+            write_string(&objFile, "usemtl object_color_");
+            write_int(&objFile, -faces[i].textureIdx);
+        }
+
+        write_string(&objFile, "\nf");
+        for (v = 0; v < faces[i].numVertices; v++)
+        {
+            write_char(&objFile, ' ');
+            write_uint(&objFile, (faceIndices[(i * 8) + (v * 2) + 0] + 1));
+            write_char(&objFile, '/');
+            write_uint(&objFile, (faceIndices[(i * 8) + (v * 2) + 1] + 1));
+        }
+        write_char(&objFile, '\n');
+    }
+
+    writer_close(&objFile);
+    writer_close(&mtlFile);
+
+    weld_table_free(&vertices);
+    weld_table_free(&uvs);
+    weld_table_free(&materials);
+    free(faceIndices);
+
+    return;
+}
+
+static uint32_t CRC32_TABLE[256];
+static pthread_once_t CRC32_TABLE_INIT = PTHREAD_ONCE_INIT;
+
+void init_crc32_table(void)
+{
+    unsigned i = 0, k = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+
+        for (k = 0; k < 8; k++)
+        {
+            crc = ((crc & 1)? (0xedb88320u ^ (crc >> 1)) : (crc >> 1));
+        }
+
+        CRC32_TABLE[i] = crc;
+    }
+
+    return;
+}
+
+uint32_t crc32(const uint8_t *const data, const size_t numBytes)
+{
+    uint32_t crc = 0xffffffffu;
+    size_t i = 0;
+
+    pthread_once(&CRC32_TABLE_INIT, init_crc32_table);
+
+    for (i = 0; i < numBytes; i++)
+    {
+        crc = (CRC32_TABLE[(crc ^ data[i]) & 0xff] ^ (crc >> 8));
+    }
+
+    return (crc ^ 0xffffffffu);
+}
+
+uint32_t adler32(const uint8_t *const data, const size_t numBytes)
+{
+    uint32_t a = 1, b = 0;
+    size_t i = 0;
+
+    while (i < numBytes)
+    {
+        /* 5552 is the most bytes that can be summed before the sums can overflow.*/
+        const size_t blockEnd = (((numBytes - i) > 5552)? (i + 5552) : numBytes);
+
+        for (; i < blockEnd; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return ((b << 16) | a);
+}
+
+/* Writes a stream of bits into a byte buffer, least significant bit first, as
+ * deflate wants them.*/
+struct bit_writer_s
+{
+    struct byte_buffer_s *dst;
+    uint32_t bits;
+    unsigned numBits;
+};
+
+void put_bits(struct bit_writer_s *const writer, const uint32_t value, const unsigned numBits)
+{
+    writer->bits |= (value << writer->numBits);
+    writer->numBits += numBits;
+
+    while (writer->numBits >= 8)
+    {
+        byte_buffer_put_byte(writer->dst, (writer->bits & 0xff));
+        writer->bits >>= 8;
+        writer->numBits -= 8;
+    }
+
+    return;
+}
+
+/* Huffman codes are stored most significant bit first, unlike everything else.*/
+void put_huffman_code(struct bit_writer_s *const writer, const uint32_t code, const unsigned numBits)
+{
+    uint32_t reversed = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < numBits; i++)
+    {
+        reversed |= (((code >> i) & 1) << (numBits - 1 - i));
+    }
+
+    put_bits(writer, reversed, numBits);
+
+    return;
+}
+
+/* Writes a literal/length symbol using deflate's fixed Huffman codes.*/
+void put_fixed_literal(struct bit_writer_s *const writer, const unsigned symbol)
+{
+    if (symbol < 144) put_huffman_code(writer, (0x30 + symbol), 8);
+    else if (symbol < 256) put_huffman_code(writer, (0x190 + (symbol - 144)), 9);
+    else if (symbol < 280) put_huffman_code(writer, (symbol - 256), 7);
+    else put_huffman_code(writer, (0xc0 + (symbol - 280)), 8);
+
+    return;
+}
+
+void put_fixed_match(struct bit_writer_s *const writer, const unsigned length, const unsigned distance)
+{
+    static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t lengthExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                              257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                              8193, 12289, 16385, 24577};
+    static const uint8_t distanceExtraBits[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    unsigned code = 28;
+
+    while (lengthBase[code] > length) code--;
+    put_fixed_literal(writer, (257 + code));
+    put_bits(writer, (length - lengthBase[code]), lengthExtraBits[code]);
+
+    code = 29;
+    while (distanceBase[code] > distance) code--;
+    put_huffman_code(writer, code, 5);
+    put_bits(writer, (distance - distanceBase[code]), distanceExtraBits[code]);
+
+    return;
+}
+
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_HASH_SIZE (1 << 15)
+#define DEFLATE_MAX_CHAIN 64
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+/* Appends the given data into the buffer as a zlib stream, compressed as a single
+ * deflate block of LZ77 matches and fixed Huffman codes.*/
+void zlib_compress(const uint8_t *const src, const size_t srcLength, struct byte_buffer_s *const dst)
+{
+    struct bit_writer_s writer;
+    int32_t *const head = malloc(sizeof(int32_t) * DEFLATE_HASH_SIZE);
+    int32_t *const prev = malloc(sizeof(int32_t) * DEFLATE_WINDOW_SIZE);
+    size_t pos = 0;
+    unsigned i = 0;
+
+    assert((head && prev) && "Failed to allocate memory for compressing data.");
+
+    for (i = 0; i < DEFLATE_HASH_SIZE; i++)
+    {
+        head[i] = -1;
+    }
+
+    #define HASH_AT(p) ((((src[p] << 10) ^ (src[(p)+1] << 5) ^ src[(p)+2]) * 2654435761u) >> 17)
+
+    #define INSERT_HASH(p) if (((p) + DEFLATE_MIN_MATCH) <= srcLength)\
+                           {\
+                               const uint32_t hash = HASH_AT(p);\
+                               prev[(p) % DEFLATE_WINDOW_SIZE] = head[hash];\
+                               head[hash] = (p);\
+                           }
+
+    writer.dst = dst;
+    writer.bits = 0;
+    writer.numBits = 0;
+
+    /* The zlib header: deflate with a 32 KB window, no preset dictionary.*/
+    byte_buffer_put_byte(dst, 0x78);
+    byte_buffer_put_byte(dst, 0x01);
+
+    put_bits(&writer, 1, 1); /* The final block.*/
+    put_bits(&writer, 1, 2); /* Fixed Huffman codes.*/
+
+    while (pos < srcLength)
+    {
+        unsigned bestLength = 0;
+        unsigned bestDistance = 0;
+
+        if ((pos + DEFLATE_MIN_MATCH) <= srcLength)
+        {
+            const unsigned maxLength = (((srcLength - pos) > DEFLATE_MAX_MATCH)? DEFLATE_MAX_MATCH : (srcLength - pos));
+            int32_t candidate = head[HASH_AT(pos)];
+            unsigned chainLength = DEFLATE_MAX_CHAIN;
+
+            while ((candidate >= 0) &&
+                   ((pos - candidate) <= DEFLATE_WINDOW_SIZE) &&
+                   chainLength--)
+            {
+                unsigned length = 0;
+
+                while ((length < maxLength) && (src[candidate + length] == src[pos + length]))
+                {
+                    length++;
+                }
+
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = (pos - candidate);
+
+                    if (length == maxLength)
+                    {
+                        break;
+                    }
+                }
+
+                candidate = prev[candidate % DEFLATE_WINDOW_SIZE];
+            }
+        }
+
+        if (bestLength >= DEFLATE_MIN_MATCH)
+        {
+            put_fixed_match(&writer, bestLength, bestDistance);
+
+            for (i = 0; i < bestLength; i++, pos++)
+            {
+                INSERT_HASH(pos);
+            }
+        }
+        else
+        {
+            put_fixed_literal(&writer, src[pos]);
+            INSERT_HASH(pos);
+            pos++;
+        }
+    }
+
+    #undef INSERT_HASH
+    #undef HASH_AT
+
+    put_fixed_literal(&writer, 256); /* End of block.*/
+
+    if (writer.numBits)
+    {
+        put_bits(&writer, 0, (8 - writer.numBits));
+    }
+
+    byte_buffer_put_be32(dst, adler32(src, srcLength));
+
+    free(head);
+    free(prev);
+
+    return;
+}
+
+void put_png_chunk(struct byte_buffer_s *const png, const char *const type, const uint8_t *const data, const size_t numBytes)
+{
+    size_t typeOffset = 0;
+
+    byte_buffer_put_be32(png, numBytes);
+
+    typeOffset = png->size;
+    byte_buffer_append(png, type, 4);
+    byte_buffer_append(png, data, numBytes);
+
+    byte_buffer_put_be32(png, crc32((png->data + typeOffset), (numBytes + 4)));
+
+    return;
+}
+
+/* Returns the Paeth predictor of the PNG spec.*/
+uint8_t paeth_predictor(const int a, const int b, const int c)
+{
+    const int p = (a + b - c);
+    const int pa = abs(p - a);
+    const int pb = abs(p - b);
+    const int pc = abs(p - c);
+
+    if ((pa <= pb) && (pa <= pc)) return a;
+    else if (pb <= pc) return b;
+    else return c;
+}
+
+/* Fills the given table with the 768-byte palette's colors as RGBA, each entry's
+ * bytes in the order r, g, b, a. Index 0 is fully transparent, as in trt2png.php.*/
+void make_rgba_palette(uint32_t *const rgbaPalette, const uint8_t *const palette)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < 256; i++)
+    {
+        const uint8_t rgba[4] = {(i? palette[i * 3 + 0] : 0),
+                                 (i? palette[i * 3 + 1] : 0),
+                                 (i? palette[i * 3 + 2] : 0),
+                                 (i? 255 : 0)};
+
+        memcpy(&rgbaPalette[i], rgba, 4);
+    }
+
+    return;
+}
+
+void expand_to_rgba_scalar(uint8_t *const dst,
+                           const uint8_t *const src,
+                           const size_t numPixels,
+                           const uint32_t *const rgbaPalette)
+{
+    size_t i = 0;
+
+    for (i = 0; i < numPixels; i++)
+    {
+        memcpy(&dst[i * 4], &rgbaPalette[src[i]], 4);
+    }
+
+    return;
+}
+
+#ifdef HAS_AVX2_KERNELS
+/* Looks up 16 pixels' colors at a time with two 8-wide gathers.*/
+__attribute__((target("avx2")))
+void expand_to_rgba_avx2(uint8_t *const dst,
+                         const uint8_t *const src,
+                         const size_t numPixels,
+                         const uint32_t *const rgbaPalette)
+{
+    size_t i = 0;
+
+    for (i = 0; (i + 16) <= numPixels; i += 16)
+    {
+        const __m128i indices = _mm_loadu_si128((const __m128i*)&src[i]);
+        const __m256i lowIndices = _mm256_cvtepu8_epi32(indices);
+        const __m256i highIndices = _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8));
+
+        _mm256_storeu_si256((__m256i*)&dst[i * 4], _mm256_i32gather_epi32((const int*)rgbaPalette, lowIndices, 4));
+        _mm256_storeu_si256((__m256i*)&dst[(i + 8) * 4], _mm256_i32gather_epi32((const int*)rgbaPalette, highIndices, 4));
+    }
+
+    expand_to_rgba_scalar(&dst[i * 4], &src[i], (numPixels - i), rgbaPalette);
+
+    return;
+}
+#endif
+
+/* Expands the given palette indices into 4 bytes of RGBA per pixel, looking each
+ * up in the given table (see make_rgba_palette()).*/
+void expand_to_rgba(uint8_t *const dst,
+                    const uint8_t *const src,
+                    const size_t numPixels,
+                    const uint32_t *const rgbaPalette)
+{
+    #ifdef HAS_AVX2_KERNELS
+        if (__builtin_cpu_supports("avx2"))
+        {
+            expand_to_rgba_avx2(dst, src, numPixels, rgbaPalette);
+            return;
+        }
+    #endif
+
+    expand_to_rgba_scalar(dst, src, numPixels, rgbaPalette);
+
+    return;
+}
+
+/* Appends the given palettized image as a PNG file into the given buffer. If
+ * isRGBA is true, the image is stored as 32-bit RGBA; otherwise, as an 8-bit
+ * indexed-color image. Either way, palette index 0 is fully transparent, as in
+ * trt2png.php.*/
+void encode_png(struct byte_buffer_s *const png,
+                const unsigned width,
+                const unsigned height,
+                const uint8_t *const pixels,
+                const uint8_t *const palette,
+                const unsigned isRGBA)
+{
+    const unsigned bytesPerPixel = (isRGBA? 4 : 1);
+    const size_t rowLength = (1 + (width * bytesPerPixel)); /* Each row starts with a filter type.*/
+    uint8_t *const imageData = malloc(rowLength * height);
+    struct byte_buffer_s compressed = {NULL, 0, 0};
+    unsigned x = 0, y = 0;
+
+    assert(imageData && "Failed to allocate memory for a PNG image.");
+
+    if (isRGBA)
+    {
+        uint8_t *const rgba = malloc(width * 4 * 2); /* The current row and the one above it.*/
+        uint8_t *filtered = malloc(rowLength * 4);   /* The row with each of the non-trivial filters applied.*/
+        uint32_t rgbaPalette[256];
+
+        assert((rgba && filtered) && "Failed to allocate memory for a PNG image.");
+
+        memset(rgba, 0, (width * 4 * 2));
+        make_rgba_palette(rgbaPalette, palette);
+
+        for (y = 0; y < height; y++)
+        {
+            uint8_t *const row = &rgba[(y % 2) * width * 4];
+            const uint8_t *const above = &rgba[((y + 1) % 2) * width * 4];
+            unsigned bestFilter = 0;
+            unsigned long bestSum = ~0ul;
+            unsigned f = 0;
+
+            expand_to_rgba(row, &pixels[y * width], width, rgbaPalette);
+
+            /* Pick the filter whose output has the smallest sum of absolute
+             * values, the usual heuristic for the most compressible one.*/
+            for (f = 0; f < 5; f++)
+            {
+                uint8_t *const dst = ((f == 0)? &imageData[y * rowLength] : &filtered[(f - 1) * rowLength]);
+                unsigned long sum = 0;
+
+                dst[0] = f;
+
+                for (x = 0; x < (width * 4); x++)
+                {
+                    const int left = ((x >= 4)? row[x - 4] : 0);
+                    const int up = ((y > 0)? above[x] : 0);
+                    const int upLeft = (((x >= 4) && (y > 0))? above[x - 4] : 0);
+                    uint8_t value = row[x];
+
+                    switch (f)
+                    {
+                        case 1: value -= left; break;
+                        case 2: value -= up; break;
+                        case 3: value -= ((left + up) / 2); break;
+                        case 4: value -= paeth_predictor(left, up, upLeft); break;
+                        default: break;
+                    }
+
+                    dst[1 + x] = value;
+                    sum += ((value < 128)? value : (256 - value));
+                }
+
+                if (sum < bestSum)
+                {
+                    bestSum = sum;
+                    bestFilter = f;
+                }
+            }
+
+            if (bestFilter)
+            {
+                memcpy(&imageData[y * rowLength], &filtered[(bestFilter - 1) * rowLength], rowLength);
+            }
+        }
+
+        free(rgba);
+        free(filtered);
+    }
+    else
+    {
+        for (y = 0; y < height; y++)
+        {
+            imageData[y * rowLength] = 0;
+            memcpy(&imageData[(y * rowLength) + 1], &pixels[y * width], width);
+        }
+    }
+
+    zlib_compress(imageData, (rowLength * height), &compressed);
+
+    /* Assemble the file.*/
+    {
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        static const uint8_t transparency[1] = {0}; /* Palette index 0 is transparent.*/
+        uint8_t header[13];
+
+        header[0] = ((width >> 24) & 0xff);
+        header[1] = ((width >> 16) & 0xff);
+        header[2] = ((width >> 8) & 0xff);
+        header[3] = (width & 0xff);
+        header[4] = ((height >> 24) & 0xff);
+        header[5] = ((height >> 16) & 0xff);
+        header[6] = ((height >> 8) & 0xff);
+        header[7] = (height & 0xff);
+        header[8] = 8;               /* Bit depth.*/
+        header[9] = (isRGBA? 6 : 3); /* Color type.*/
+        header[10] = 0;              /* Compression method.*/
+        header[11] = 0;              /* Filter method.*/
+        header[12] = 0;              /* No interlacing.*/
+
+        byte_buffer_append(png, signature, sizeof(signature));
+        put_png_chunk(png, "IHDR", header, sizeof(header));
+
+        if (!isRGBA)
+        {
+            put_png_chunk(png, "PLTE", palette, 768);
+            put_png_chunk(png, "tRNS", transparency, sizeof(transparency));
+        }
+
+        put_png_chunk(png, "IDAT", compressed.data, compressed.size);
+        put_png_chunk(png, "IEND", NULL, 0);
+    }
+
+    byte_buffer_free(&compressed);
+    free(imageData);
+
+    return;
+}
+
+/* Saves the given palettized image as a PNG file; see encode_png().*/
+void save_png(const struct level_s *const level,
+              const char *const filename,
+              const unsigned width,
+              const unsigned height,
+              const uint8_t *const pixels,
+              const uint8_t *const palette,
+              const unsigned isRGBA)
+{
+    struct byte_buffer_s png = {NULL, 0, 0};
+
+    encode_png(&png, width, height, pixels, palette, isRGBA);
+    save_output_file(level, filename, png.data, png.size);
+    byte_buffer_free(&png);
+
+    return;
+}
+
+/* Saves a list mapping each object texture to its unique texture image, as the
+ * image index of object texture n on line n+1.*/
+void save_texture_image_index(const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    char filename[MAX_PATH_LENGTH];
+    char outputBuffer[OUTPUT_BUFFER_SIZE];
+    struct output_writer_s outFile;
+    unsigned i = 0;
+
+    make_output_filename(filename, level, "texture/image/index.txt");
+    writer_open(&outFile, level, filename, outputBuffer, sizeof(outputBuffer));
+
+    for (i = 0; i < importedData->numObjectTextures; i++)
+    {
+        write_uint(&outFile, importedData->objectTextures[i].imageIdx);
+        write_char(&outFile, '\n');
+    }
+
+    writer_close(&outFile);
+
+    return;
+}
+
+/* Saves the level's texture atlases followed by its object textures (or, when
+ * deduplicating textures, its unique texture images; or when repacking them,
+ * its texture pages) as PNG files, one texture per task.*/
+void save_texture_png_task(void *const context, const unsigned taskIdx)
+{
+    const struct level_s *const level = context;
+    const struct imported_data_s *const importedData = &level->importedData;
+    char filename[MAX_PATH_LENGTH];
+
+    if (taskIdx < importedData->numTextureAtlases)
+    {
+        const struct tr_texture_atlas_s *const texture = &importedData->textureAtlases[taskIdx];
+
+        if (!(level->exportParts & EXPORT_TEXTURE_ATLASES))
+        {
+            return;
+        }
+
+        make_output_filename(filename, level, "texture/atlas/%d.png", taskIdx);
+        save_png(level, filename, texture->width, texture->height, texture->pixelData, importedData->palette,
+                 (level->textureFormats & TEXTURE_FORMAT_PNG_RGBA));
+    }
+    else if (level->repackTextures)
+    {
+        const unsigned pageIdx = (taskIdx - importedData->numTextureAtlases);
+        const struct tr_texture_page_s *const page = &importedData->texturePages[pageIdx];
+
+        if (!(level->exportParts & EXPORT_OBJECT_TEXTURES))
+        {
+            return;
+        }
+
+        make_output_filename(filename, level, "texture/page/%u.png", pageIdx);
+        save_png(level, filename, page->width, page->height, page->pixelData, importedData->palette,
+                 (level->textureFormats & TEXTURE_FORMAT_PNG_RGBA));
+    }
+    else if (level->dedupTextures)
+    {
+        const unsigned imageIdx = (taskIdx - importedData->numTextureAtlases);
+        const struct tr_texture_image_s *const image = &importedData->textureImages[imageIdx];
+
+        if (!importedData->textureImageIsSelected[imageIdx])
+        {
+            return;
+        }
+
+        make_output_filename(filename, level, "texture/image/%d.png", imageIdx);
+        save_png(level, filename, image->width, image->height, image->pixelData, importedData->palette,
+                 (level->textureFormats & TEXTURE_FORMAT_PNG_RGBA));
+    }
+    else
+    {
+        const unsigned textureIdx = (taskIdx - importedData->numTextureAtlases);
+        const struct tr_object_texture_s *const texture = &importedData->objectTextures[textureIdx];
+
+        if (!importedData->objectTextureIsSelected[textureIdx])
+        {
+            return;
+        }
+
+        make_output_filename(filename, level, "texture/object/%d.png", textureIdx);
+        save_png(level, filename, texture->width, texture->height, texture->pixelData, importedData->palette,
+                 (level->textureFormats & TEXTURE_FORMAT_PNG_RGBA));
+    }
+
+    return;
+}
+
+/* Appends a comma into the given JSON array unless it's still empty, and returns
+ * the index of the element that's about to be appended.*/
+unsigned glb_new_element(struct byte_buffer_s *const array, unsigned *const numElements)
+{
+    if (*numElements)
+    {
+        byte_buffer_put_byte(array, ',');
+    }
+
+    return (*numElements)++;
+}
+
+/* Appends the given bytes into the binary buffer as a buffer view, aligned to 4
+ * bytes, and returns the view's index. A byteStride or target of 0 is left out.*/
+unsigned glb_add_buffer_view(struct glb_builder_s *const glb,
+                             const void *const data,
+                             const size_t numBytes,
+                             const unsigned byteStride,
+                             const unsigned target)
+{
+    const unsigned viewIdx = glb_new_element(&glb->bufferViews, &glb->numBufferViews);
+
+    while (glb->bin.size % 4)
+    {
+        byte_buffer_put_byte(&glb->bin, 0);
+    }
+
+    byte_buffer_printf(&glb->bufferViews, "{\"buffer\":0,\"byteOffset\":%lu,\"byteLength\":%lu",
+                       (unsigned long)glb->bin.size, (unsigned long)numBytes);
+    if (byteStride) byte_buffer_printf(&glb->bufferViews, ",\"byteStride\":%u", byteStride);
+    if (target) byte_buffer_printf(&glb->bufferViews, ",\"target\":%u", target);
+    byte_buffer_put_byte(&glb->bufferViews, '}');
+
+    byte_buffer_append(&glb->bin, data, numBytes);
+
+    return viewIdx;
+}
+
+/* Returns the glTF material for faces with the given texture index (as in
+ * export_face_s), creating it and its texture and embedded PNG image on first
+ * use. Untextured faces share a material that takes its color from the vertex
+ * colors.*/
+unsigned glb_material(struct glb_builder_s *const glb, const struct level_s *const level, const int textureIdx)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const struct tr_object_texture_s *const texture = ((!level->repackTextures && (textureIdx >= 0) &&
+                                                        ((unsigned)textureIdx < importedData->numObjectTextures))?
+                                                       &importedData->objectTextures[textureIdx]
+                                                       : NULL);
+    const struct tr_texture_page_s *const page = ((level->repackTextures && (textureIdx >= 0) &&
+                                                   ((unsigned)textureIdx < importedData->numTexturePages))?
+                                                  &importedData->texturePages[textureIdx]
+                                                  : NULL);
+    unsigned materialIdx = 0;
+
+    if ((!texture || !texture->pixelData) &&
+        (!page || !page->pixelData))
+    {
+        if (glb->untexturedMaterial == GLB_NONE)
+        {
+            glb->untexturedMaterial = glb_new_element(&glb->materials, &glb->numMaterials);
+            byte_buffer_printf(&glb->materials, "{\"name\":\"untextured\","
+                                                "\"pbrMetallicRoughness\":{\"metallicFactor\":0,\"roughnessFactor\":1},"
+                                                "\"doubleSided\":true}");
+        }
+
+        return glb->untexturedMaterial;
+    }
+
+    if (glb->textureMaterials[textureIdx] != GLB_NONE)
+    {
+        return glb->textureMaterials[textureIdx];
+    }
+
+    /* A texture page is used by its faces' materials alone, so it comes with a
+     * glTF texture and image of its own. There are never more pages than object
+     * textures.*/
+    if (page)
+    {
+        struct byte_buffer_s png = {NULL, 0, 0};
+        unsigned imageIdx = 0, viewIdx = 0, pageTextureIdx = 0;
+
+        encode_png(&png, page->width, page->height, page->pixelData, importedData->palette,
+                   (level->textureFormats & TEXTURE_FORMAT_PNG_RGBA));
+        viewIdx = glb_add_buffer_view(glb, png.data, png.size, 0, 0);
+        byte_buffer_free(&png);
+
+        imageIdx = glb_new_element(&glb->images, &glb->numImages);
+        byte_buffer_printf(&glb->images, "{\"name\":\"texture_page_%d\",\"bufferView\":%u,\"mimeType\":\"image/png\"}",
+                           textureIdx, viewIdx);
+
+        pageTextureIdx = glb_new_element(&glb->textures, &glb->numTextures);
+        byte_buffer_printf(&glb->textures, "{\"sampler\":0,\"source\":%u}", imageIdx);
+
+        materialIdx = glb_new_element(&glb->materials, &glb->numMaterials);
+        byte_buffer_printf(&glb->materials, "{\"name\":\"texture_page_%d\","
+                                            "\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":%u},\"metallicFactor\":0,\"roughnessFactor\":1},"
+                                            "\"alphaMode\":\"MASK\",\"doubleSided\":true}",
+                           textureIdx, pageTextureIdx);
+
+        glb->textureMaterials[textureIdx] = materialIdx;
+
+        return materialIdx;
+    }
+
+    if (glb->imageTextures[texture->imageIdx] == GLB_NONE)
+    {
+        const struct tr_texture_image_s *const image = &importedData->textureImages[texture->imageIdx];
+        struct byte_buffer_s png = {NULL, 0, 0};
+        unsigned imageIdx = 0, viewIdx = 0;
+
+        encode_png(&png, image->width, image->height, image->pixelData, importedData->palette,
+                   (level->textureFormats & TEXTURE_FORMAT_PNG_RGBA));
+        viewIdx = glb_add_buffer_view(glb, png.data, png.size, 0, 0);
+        byte_buffer_free(&png);
+
+        imageIdx = glb_new_element(&glb->images, &glb->numImages);
+        byte_buffer_printf(&glb->images, "{\"name\":\"image_%u\",\"bufferView\":%u,\"mimeType\":\"image/png\"}",
+                           texture->imageIdx, viewIdx);
+
+        glb->imageTextures[texture->imageIdx] = glb_new_element(&glb->textures, &glb->numTextures);
+        byte_buffer_printf(&glb->textures, "{\"sampler\":0,\"source\":%u}", imageIdx);
+    }
+
+    /* Palette index 0 is transparent in every texture.*/
+    materialIdx = glb_new_element(&glb->materials, &glb->numMaterials);
+    byte_buffer_printf(&glb->materials, "{\"name\":\"object_texture_%d\","
+                                        "\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":%u},\"metallicFactor\":0,\"roughnessFactor\":1},"
+                                        "\"alphaMode\":\"MASK\",\"doubleSided\":true}",
+                       textureIdx, glb->imageTextures[texture->imageIdx]);
+
+    glb->textureMaterials[textureIdx] = materialIdx;
+
+    return materialIdx;
+}
+
+/* Adds the given faces into the GLB file as a mesh, and returns the mesh's index;
+ * or GLB_NONE if there are no faces. The mesh has one interleaved vertex buffer,
+ * and one primitive of indexed triangles per texture index, with 16-bit indices
+ * unless there are too many vertices.*/
+unsigned glb_add_mesh(struct glb_builder_s *const glb,
+                      const struct level_s *const level,
+                      const char *const name,
+                      const struct export_face_s *const faces,
+                      const unsigned numFaces)
+{
+    const uint8_t *const palette = level->importedData.palette;
+    struct weld_table_s vertices, groups;
+    uint32_t *cornerVertices = NULL; /* The welded vertex of each face's each corner.*/
+    unsigned *groupStart = NULL;     /* Where each group's triangles begin in the index buffer.*/
+    unsigned numTriangles = 0;
+    unsigned positionMin[3], positionMax[3];
+    unsigned vertexViewIdx = 0, indexViewIdx = 0;
+    unsigned meshIdx = 0, positionIdx = 0;
+    unsigned i = 0, v = 0;
+
+    if (!numFaces)
+    {
+        return GLB_NONE;
+    }
+
+    stats_count_faces(level, numFaces);
+
+    weld_table_init(&vertices, 6, (numFaces * 2));
+    weld_table_init(&groups, 1, 64);
+
+    cornerVertices = malloc(sizeof(uint32_t) * 4 * numFaces);
+    assert(cornerVertices && "Failed to allocate memory for a glTF mesh.");
+
+    /* Weld the vertices, which differ from each other by position, UV or color.*/
+    for (i = 0; i < numFaces; i++)
+    {
+        const uint32_t groupKey = faces[i].textureIdx;
+
+        for (v = 0; v < faces[i].numVertices; v++)
+        {
+            const int lighting = ((faces[i].lighting[v] < 0)? 0 : (faces[i].lighting[v] > 8191)? 8191 : faces[i].lighting[v]);
+            const unsigned brightness = (255 - ((lighting * 255) / 8191));
+            uint32_t vertexKey[6];
+            uint8_t color[4];
+
+            if (faces[i].textureIdx >= 0)
+            {
+                color[0] = color[1] = color[2] = brightness;
+            }
+            else
+            {
+                color[0] = ((palette[-faces[i].textureIdx * 3 + 0] * brightness) / 255);
+                color[1] = ((palette[-faces[i].textureIdx * 3 + 1] * brightness) / 255);
+                color[2] = ((palette[-faces[i].textureIdx * 3 + 2] * brightness) / 255);
+            }
+            color[3] = 255;
+
+            vertexKey[0] = faces[i].x[v];
+            vertexKey[1] = faces[i].y[v];
+            vertexKey[2] = faces[i].z[v];
+            memcpy(&vertexKey[3], &faces[i].u[v], sizeof(float));
+            memcpy(&vertexKey[4], &faces[i].v[v], sizeof(float));
+            memcpy(&vertexKey[5], color, sizeof(color));
+
+            cornerVertices[(i * 4) + v] = weld_table_insert(&vertices, vertexKey);
+        }
+
+        weld_table_insert(&groups, &groupKey);
+        numTriangles += (faces[i].numVertices - 2);
+    }
+
+    /* Save the vertex buffer.*/
+    {
+        uint8_t *const vertexData = malloc(GLB_VERTEX_SIZE * vertices.numKeys);
+        assert(vertexData && "Failed to allocate memory for a glTF mesh.");
+
+        for (v = 0; v < 3; v++)
+        {
+            positionMin[v] = vertices.keys[v];
+            positionMax[v] = vertices.keys[v];
+        }
+
+        for (i = 0; i < vertices.numKeys; i++)
+        {
+            const uint32_t *const key = &vertices.keys[i * 6];
+            uint8_t *const dst = &vertexData[i * GLB_VERTEX_SIZE];
+
+            for (v = 0; v < 3; v++)
+            {
+                const float position = (int32_t)key[v];
+                uint32_t bits = 0;
+
+                memcpy(&bits, &position, sizeof(bits));
+                put_le32(&dst[v * 4], bits);
+
+                if ((int32_t)key[v] < (int32_t)positionMin[v]) positionMin[v] = key[v];
+                if ((int32_t)key[v] > (int32_t)positionMax[v]) positionMax[v] = key[v];
+            }
+
+            put_le32(&dst[12], key[3]);
+            put_le32(&dst[16], key[4]);
+            memcpy(&dst[20], &key[5], 4);
+        }
+
+        vertexViewIdx = glb_add_buffer_view(glb, vertexData, (GLB_VERTEX_SIZE * vertices.numKeys), GLB_VERTEX_SIZE, 34962);
+
+        free(vertexData);
+    }
+
+    /* Save the index buffer, with the triangles grouped by texture.*/
+    {
+        const unsigned indexSize = ((vertices.numKeys > 0xffff)? 4 : 2);
+        uint8_t *const indexData = malloc(indexSize * 3 * numTriangles);
+        unsigned *const groupEnd = calloc(groups.numKeys, sizeof(unsigned));
+
+        groupStart = calloc(groups.numKeys + 1, sizeof(unsigned));
+        assert((indexData && groupStart && groupEnd) && "Failed to allocate memory for a glTF mesh.");
+
+        for (i = 0; i < numFaces; i++)
+        {
+            const uint32_t groupKey = faces[i].textureIdx;
+
+            groupStart[weld_table_find(&groups, &groupKey) + 1] += (faces[i].numVertices - 2);
+        }
+
+        for (i = 0; i < groups.numKeys; i++)
+        {
+            groupStart[i + 1] += groupStart[i];
+            groupEnd[i] = groupStart[i];
+        }
+
+        /* Split quads into two triangles.*/
+        for (i = 0; i < numFaces; i++)
+        {
+            const uint32_t groupKey = faces[i].textureIdx;
+            const unsigned groupIdx = weld_table_find(&groups, &groupKey);
+
+            for (v = 2; v < faces[i].numVertices; v++)
+            {
+                const uint32_t triangle[3] = {cornerVertices[i * 4], cornerVertices[(i * 4) + v - 1], cornerVertices[(i * 4) + v]};
+                uint8_t *const dst = &indexData[groupEnd[groupIdx]++ * 3 * indexSize];
+                unsigned k = 0;
+
+                for (k = 0; k < 3; k++)
+                {
+                    if (indexSize == 4)
+                    {
+                        put_le32(&dst[k * 4], triangle[k]);
+                    }
+                    else
+                    {
+                        dst[k * 2 + 0] = (triangle[k] & 0xff);
+                        dst[k * 2 + 1] = ((triangle[k] >> 8) & 0xff);
+                    }
+                }
+            }
+        }
+
+        indexViewIdx = glb_add_buffer_view(glb, indexData, (indexSize * 3 * numTriangles), 0, 34963);
+
+        free(indexData);
+        free(groupEnd);
+
+        /* The vertex attributes, shared by the primitives.*/
+        positionIdx = glb_new_element(&glb->accessors, &glb->numAccessors);
+        byte_buffer_printf(&glb->accessors, "{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\","
+                                            "\"min\":[%d,%d,%d],\"max\":[%d,%d,%d]}",
+                           vertexViewIdx, vertices.numKeys,
+                           (int32_t)positionMin[0], (int32_t)positionMin[1], (int32_t)positionMin[2],
+                           (int32_t)positionMax[0], (int32_t)positionMax[1], (int32_t)positionMax[2]);
+        glb_new_element(&glb->accessors, &glb->numAccessors);
+        byte_buffer_printf(&glb->accessors, "{\"bufferView\":%u,\"byteOffset\":12,\"componentType\":5126,\"count\":%u,\"type\":\"VEC2\"}",
+                           vertexViewIdx, vertices.numKeys);
+        glb_new_element(&glb->accessors, &glb->numAccessors);
+        byte_buffer_printf(&glb->accessors, "{\"bufferView\":%u,\"byteOffset\":20,\"componentType\":5121,\"normalized\":true,\"count\":%u,\"type\":\"VEC4\"}",
+                           vertexViewIdx, vertices.numKeys);
+
+        meshIdx = glb_new_element(&glb->meshes, &glb->numMeshes);
+        byte_buffer_printf(&glb->meshes, "{\"name\":\"%s\",\"primitives\":[", name);
+
+        for (i = 0; i < groups.numKeys; i++)
+        {
+            const unsigned materialIdx = glb_material(glb, level, (int32_t)groups.keys[i]);
+            const unsigned indicesIdx = glb_new_element(&glb->accessors, &glb->numAccessors);
+
+            byte_buffer_printf(&glb->accessors, "{\"bufferView\":%u,\"byteOffset\":%u,\"componentType\":%u,\"count\":%u,\"type\":\"SCALAR\"}",
+                               indexViewIdx, (groupStart[i] * 3 * indexSize), ((indexSize == 4)? 5125 : 5123),
+                               ((groupStart[i + 1] - groupStart[i]) * 3));
+
+            byte_buffer_printf(&glb->meshes, "%s{\"attributes\":{\"POSITION\":%u,\"TEXCOORD_0\":%u,\"COLOR_0\":%u},"
+                                             "\"indices\":%u,\"material\":%u}",
+                               (i? "," : ""), positionIdx, (positionIdx + 1), (positionIdx + 2), indicesIdx, materialIdx);
+        }
+
+        byte_buffer_printf(&glb->meshes, "]}");
+    }
+
+    weld_table_free(&vertices);
+    weld_table_free(&groups);
+    free(cornerVertices);
+    free(groupStart);
+
+    return meshIdx;
+}
+
+/* Saves the selected rooms as a single glTF 2.0 binary file, mesh/level.glb.
+ * Each room is a node with a mesh of its own, and each of its static objects a
+ * child node instancing a mesh shared by all of the objects that use it. The
+ * object textures used are embedded as PNG images.
+ *
+ * The meshes are in the level's own coordinates, where y points down; the root
+ * node turns them the right way up for glTF.*/
+void save_level_glb(const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const char *const rotations[] = {"0,0,0,1", "0,0.70710678,0,0.70710678", "0,1,0,0", "0,0.70710678,0,-0.70710678"};
+    struct glb_builder_s glb;
+    struct byte_buffer_s roomNodes = {NULL, 0, 0}; /* The root node's children.*/
+    struct byte_buffer_s json = {NULL, 0, 0};
+    struct byte_buffer_s file = {NULL, 0, 0};
+    unsigned *objectMeshes = NULL; /* The glTF mesh of each mesh in the master list.*/
+    unsigned numRoomNodes = 0;
+    unsigned i = 0, p = 0;
+
+    memset(&glb, 0, sizeof(glb));
+    glb.untexturedMaterial = GLB_NONE;
+    glb.textureMaterials = malloc(sizeof(unsigned) * (importedData->numObjectTextures + 1));
+    glb.imageTextures = malloc(sizeof(unsigned) * (importedData->numTextureImages + 1));
+    objectMeshes = malloc(sizeof(unsigned) * (importedData->numMeshes + 1));
+
+    assert((glb.textureMaterials && glb.imageTextures && objectMeshes) &&
+           "Failed to allocate memory for a glTF file.");
+
+    memset(glb.textureMaterials, 0xff, (sizeof(unsigned) * (importedData->numObjectTextures + 1)));
+    memset(glb.imageTextures, 0xff, (sizeof(unsigned) * (importedData->numTextureImages + 1)));
+
+    /* Add the meshes of the static objects.*/
+    for (i = 0; i < importedData->numMeshes; i++)
+    {
+        objectMeshes[i] = GLB_NONE;
+
+        if (importedData->meshIsSelected[i])
+        {
+            char name[32];
+            unsigned numFaces = 0;
+            struct export_face_s *const faces = collect_object_mesh_faces(importedData, i, &numFaces);
+
+            snprintf(name, sizeof(name), "object_%u", i);
+            objectMeshes[i] = glb_add_mesh(&glb, level, name, faces, numFaces);
+
+            free(faces);
+        }
+    }
+
+    /* Add the rooms, each followed by its static objects.*/
+    for (i = 0; i < importedData->numRoomMeshes; i++)
+    {
+        const struct tr_room_mesh_s *const room = &importedData->roomMeshes[i];
+        unsigned roomNodeIdx = 0, meshIdx = 0, numFaces = 0;
+        char name[32];
+        struct export_face_s *faces = NULL;
+
+        if (!importedData->roomIsSelected[i])
+        {
+            continue;
+        }
+
+        faces = collect_faces(importedData, room, NULL, 0, &numFaces);
+        snprintf(name, sizeof(name), "room_%u", i);
+        meshIdx = glb_add_mesh(&glb, level, name, faces, numFaces);
+        free(faces);
+
+        roomNodeIdx = glb_new_element(&glb.nodes, &glb.numNodes);
+        byte_buffer_printf(&glb.nodes, "{\"name\":\"%s\"", name);
+        if (meshIdx != GLB_NONE) byte_buffer_printf(&glb.nodes, ",\"mesh\":%u", meshIdx);
+
+        if (room->numStaticObjects)
+        {
+            byte_buffer_printf(&glb.nodes, ",\"children\":[");
+            for (p = 0; p < room->numStaticObjects; p++)
+            {
+                byte_buffer_printf(&glb.nodes, "%s%u", (p? "," : ""), (roomNodeIdx + 1 + p));
+            }
+            byte_buffer_put_byte(&glb.nodes, ']');
+        }
+
+        byte_buffer_put_byte(&glb.nodes, '}');
+
+        for (p = 0; p < room->numStaticObjects; p++)
+        {
+            const struct tr_mesh_meta_s *const object = &room->staticObjects[p];
+
+            glb_new_element(&glb.nodes, &glb.numNodes);
+            byte_buffer_printf(&glb.nodes, "{\"name\":\"room_%u_static_%u\"", i, p);
+            if (objectMeshes[object->meshIdx] != GLB_NONE) byte_buffer_printf(&glb.nodes, ",\"mesh\":%u", objectMeshes[object->meshIdx]);
+            byte_buffer_printf(&glb.nodes, ",\"translation\":[%d,%d,%d],\"rotation\":[%s],\"extras\":{\"meshIdx\":%u,\"lighting\":%u}}",
+                               object->x, object->y, object->z, rotations[object->rotation & 3], object->meshIdx, object->lighting);
+        }
+
+        byte_buffer_printf(&roomNodes, "%s%u", (numRoomNodes++? "," : ""), roomNodeIdx);
+    }
+
+    /* The root node, turned 180 degrees about the x axis.*/
+    glb_new_element(&glb.nodes, &glb.numNodes);
+    byte_buffer_printf(&glb.nodes, "{\"name\":\"level\",\"rotation\":[1,0,0,0]");
+    if (numRoomNodes) byte_buffer_printf(&glb.nodes, ",\"children\":[%.*s]", (int)roomNodes.size, (const char*)roomNodes.data);
+    byte_buffer_put_byte(&glb.nodes, '}');
+
+    /* Assemble the scene description. glTF doesn't allow empty arrays.*/
+    {
+        #define PUT_ARRAY(name, array, numElements)\
+                if (numElements)\
+                {\
+                    byte_buffer_printf(&json, ",\"%s\":[%.*s]", name, (int)array.size, (const char*)array.data);\
+                }
+
+        byte_buffer_printf(&json, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"dig\"},"
+                                  "\"scene\":0,\"scenes\":[{\"nodes\":[%u]}]", (glb.numNodes - 1));
+        PUT_ARRAY("nodes", glb.nodes, glb.numNodes);
+        PUT_ARRAY("meshes", glb.meshes, glb.numMeshes);
+        PUT_ARRAY("materials", glb.materials, glb.numMaterials);
+        PUT_ARRAY("textures", glb.textures, glb.numTextures);
+        PUT_ARRAY("images", glb.images, glb.numImages);
+        PUT_ARRAY("accessors", glb.accessors, glb.numAccessors);
+        PUT_ARRAY("bufferViews", glb.bufferViews, glb.numBufferViews);
+
+        if (glb.numTextures)
+        {
+            /* Nearest-neighbor filtering, clamped to the edges of the image.*/
+            byte_buffer_printf(&json, ",\"samplers\":[{\"magFilter\":9728,\"minFilter\":9728,\"wrapS\":33071,\"wrapT\":33071}]");
+        }
+
+        if (glb.bin.size)
+        {
+            byte_buffer_printf(&json, ",\"buffers\":[{\"byteLength\":%lu}]", (unsigned long)glb.bin.size);
+        }
+
+        byte_buffer_put_byte(&json, '}');
+
+        #undef PUT_ARRAY
+    }
+
+    /* Assemble the file: a header, followed by the JSON and binary chunks, each
+     * padded to 4 bytes.*/
+    {
+        char filename[MAX_PATH_LENGTH];
+        uint8_t header[12];
+
+        while (json.size % 4) byte_buffer_put_byte(&json, ' ');
+        while (glb.bin.size % 4) byte_buffer_put_byte(&glb.bin, 0);
+
+        memcpy(header, "glTF", 4);
+        put_le32(&header[4], 2);
+        put_le32(&header[8], (12 + 8 + json.size + (glb.bin.size? (8 + glb.bin.size) : 0)));
+        byte_buffer_append(&file, header, 12);
+
+        put_le32(&header[0], json.size);
+        memcpy(&header[4], "JSON", 4);
+        byte_buffer_append(&file, header, 8);
+        byte_buffer_append(&file, json.data, json.size);
+
+        if (glb.bin.size)
+        {
+            put_le32(&header[0], glb.bin.size);
+            memcpy(&header[4], "BIN\0", 4);
+            byte_buffer_append(&file, header, 8);
+            byte_buffer_append(&file, glb.bin.data, glb.bin.size);
+        }
+
+        make_output_filename(filename, level, "mesh/level.glb");
+        save_output_file(level, filename, file.data, file.size);
+    }
+
+    byte_buffer_free(&glb.nodes);
+    byte_buffer_free(&glb.meshes);
+    byte_buffer_free(&glb.materials);
+    byte_buffer_free(&glb.textures);
+    byte_buffer_free(&glb.images);
+    byte_buffer_free(&glb.accessors);
+    byte_buffer_free(&glb.bufferViews);
+    byte_buffer_free(&glb.bin);
+    byte_buffer_free(&roomNodes);
+    byte_buffer_free(&json);
+    byte_buffer_free(&file);
+    free(glb.textureMaterials);
+    free(glb.imageTextures);
+    free(objectMeshes);
+
+    return;
+}
+
+/* Saves a list of the given room's static objects, as instances of the meshes
+ * in mesh/object/. Each line gives an object's mesh index, its world x, y and z
+ * coordinates, how many times it's rotated by 90 degrees horizontally, and its
+ * lighting (between 0 = light and 8191 = dark).*/
+void save_room_instances(const struct level_s *const level, const unsigned roomIdx)
+{
+    const struct tr_room_mesh_s *const room = &level->importedData.roomMeshes[roomIdx];
+    char filename[MAX_PATH_LENGTH];
+    char outputBuffer[OUTPUT_BUFFER_SIZE];
+    struct output_writer_s outFile;
+    unsigned i = 0;
+
+    make_output_filename(filename, level, "mesh/room/%d.instances", roomIdx);
+    writer_open(&outFile, level, filename, outputBuffer, sizeof(outputBuffer));
+
+    for (i = 0; i < room->numStaticObjects; i++)
+    {
+        const struct tr_mesh_meta_s *const object = &room->staticObjects[i];
+
+        write_uint(&outFile, object->meshIdx);
+        write_char(&outFile, ' ');
+        write_int(&outFile, object->x);
+        write_char(&outFile, ' ');
+        write_int(&outFile, object->y);
+        write_char(&outFile, ' ');
+        write_int(&outFile, object->z);
+        write_char(&outFile, ' ');
+        write_uint(&outFile, object->rotation);
+        write_char(&outFile, ' ');
+        write_uint(&outFile, object->lighting);
+        write_char(&outFile, '\n');
+    }
+
+    writer_close(&outFile);
+
+    return;
+}
+
+/* Saves the given texture in the chosen raw formats: as palette indices into a
+ * .trt file, and as 32-bit RGBA into an .rgba file. Each comes with a .mta file
+ * giving the texture's width and height.*/
+void save_raw_texture(const struct level_s *const level,
+                      const char *const path,
+                      const unsigned textureIdx,
+                      const unsigned width,
+                      const unsigned height,
+                      const uint8_t *const pixels)
+{
+    const char *const extensions[] = {"trt", "rgba"};
+    const unsigned formats[] = {TEXTURE_FORMAT_TRT, TEXTURE_FORMAT_RGBA};
+    unsigned i = 0;
+
+    for (i = 0; i < (sizeof(formats) / sizeof(formats[0])); i++)
+    {
+        struct output_writer_s metaFile;
+        char metaBuffer[64];
+        char filename[MAX_PATH_LENGTH];
+
+        if (!(level->textureFormats & formats[i]))
+        {
+            continue;
+        }
+
+        make_output_filename(filename, level, "%s%u.%s", path, textureIdx, extensions[i]);
+
+        if (formats[i] == TEXTURE_FORMAT_RGBA)
+        {
+            uint8_t *const rgba = malloc((size_t)width * height * 4);
+            uint32_t rgbaPalette[256];
+
+            assert(rgba && "Failed to allocate memory for exporting a texture.");
+
+            make_rgba_palette(rgbaPalette, level->importedData.palette);
+            expand_to_rgba(rgba, pixels, ((size_t)width * height), rgbaPalette);
+            save_output_file(level, filename, rgba, ((size_t)width * height * 4));
+
+            free(rgba);
+        }
+        else
+        {
+            save_output_file(level, filename, pixels, ((size_t)width * height));
+        }
+
+        make_output_filename(filename, level, "%s%u.%s.mta", path, textureIdx, extensions[i]);
+        writer_open(&metaFile, level, filename, metaBuffer, sizeof(metaBuffer));
+
+        write_uint(&metaFile, width);
+        write_char(&metaFile, ' ');
+        write_uint(&metaFile, height);
+
+        writer_close(&metaFile);
+    }
+
+    return;
+}
+
+/* Plans the layout of the level's texture archive and begins writing it, with
+ * its header and directory, into texture/textures.tra. The archive holds the
+ * texture atlases and the selected object textures (or when repacking textures,
+ * the texture pages) as palette indices, like .trt files do, but in a single
+ * file that can be memory-mapped and used as is. It consists of little-endian
+ * 32-bit values followed by the pixels:
+ *
+ *   header       "TRA1", numEntries, the byte offset of the directory, and
+ *                TEXTURE_ARCHIVE_ALIGNMENT
+ *   directory    per entry: kind (0 = texture atlas, 1 = object texture, 2 =
+ *                texture page), index, width, height, atlas index, x and y of
+ *                the texture's rectangle on its atlas, attribute flags (1 = has
+ *                alpha, 2 = ignores depth test, 4 = has wireframe), texture
+ *                image index (0xffffffff for atlases and pages; pages also have
+ *                0xffffffff as their atlas index), and the byte offset of the
+ *                pixels
+ *   pixels       width x height palette indices per texture, each beginning at
+ *                a multiple of TEXTURE_ARCHIVE_ALIGNMENT bytes
+ *
+ * The directory lists the atlases and then the object textures or pages, in
+ * order of index. Object textures that cover the same rectangle of the same
+ * atlas share their pixels. The pixels are laid out an atlas at a time, the
+ * atlas followed by the texture images cut out of it, so that they can be
+ * written as each atlas is exported (see texture_archive_write_atlas()); the
+ * pages, which are complete only once every atlas has been drawn onto them,
+ * come last (see texture_archive_write_pages()).*/
+void texture_archive_open(struct texture_archive_s *const archive, const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const unsigned hasAtlases = ((level->exportParts & EXPORT_TEXTURE_ATLASES) != 0);
+    const unsigned hasPages = (level->repackTextures && (level->exportParts & EXPORT_OBJECT_TEXTURES));
+    unsigned numEntries = 0, atlasIdx = 0, i = 0;
+    char filename[MAX_PATH_LENGTH];
+    uint64_t pos = 0;
+
+    archive->atlasOffsets = malloc(sizeof(uint32_t) * (importedData->numTextureAtlases + 1));
+    archive->imageOffsets = malloc(sizeof(uint32_t) * (importedData->numTextureImages + 1));
+    archive->pageOffsets = malloc(sizeof(uint32_t) * (importedData->numTexturePages + 1));
+    assert((archive->atlasOffsets && archive->imageOffsets && archive->pageOffsets) &&
+           "Failed to allocate memory for a texture archive.");
+
+    numEntries = (hasAtlases? importedData->numTextureAtlases : 0);
+
+    if (hasPages)
+    {
+        numEntries += importedData->numTexturePages;
+    }
+    else if (!level->repackTextures)
+    {
+        for (i = 0; i < importedData->numObjectTextures; i++)
+        {
+            numEntries += importedData->objectTextureIsSelected[i];
+        }
+    }
+
+    for (i = 0; i < importedData->numTextureImages; i++)
+    {
+        archive->imageOffsets[i] = TEXTURE_ARCHIVE_NONE;
+    }
+
+    for (i = 0; i < importedData->numTexturePages; i++)
+    {
+        archive->pageOffsets[i] = TEXTURE_ARCHIVE_NONE;
+    }
+
+    /* Lay the pixels out after the directory.*/
+    pos = (sizeof(uint32_t) * (TEXTURE_ARCHIVE_HEADER_NUM_WORDS + ((uint64_t)numEntries * TEXTURE_ARCHIVE_ENTRY_NUM_WORDS)));
+
+    #define PLACE_PIXELS(offset, numBytes) pos = (((pos + TEXTURE_ARCHIVE_ALIGNMENT - 1) / TEXTURE_ARCHIVE_ALIGNMENT) * TEXTURE_ARCHIVE_ALIGNMENT);\
+                                           offset = pos;\
+                                           pos += (numBytes);
+
+    for (atlasIdx = 0; atlasIdx < importedData->numTextureAtlases; atlasIdx++)
+    {
+        const struct tr_texture_atlas_s *const atlas = &importedData->textureAtlases[atlasIdx];
+
+        archive->atlasOffsets[atlasIdx] = TEXTURE_ARCHIVE_NONE;
+
+        if (hasAtlases)
+        {
+            PLACE_PIXELS(archive->atlasOffsets[atlasIdx], (atlas->width * atlas->height));
+        }
+
+        for (i = 0; i < importedData->numTextureImages; i++)
+        {
+            const struct tr_texture_image_s *const image = &importedData->textureImages[i];
+
+            if ((image->atlasIdx == atlasIdx) &&
+                importedData->textureImageIsSelected[i] &&
+                !level->repackTextures)
+            {
+                PLACE_PIXELS(archive->imageOffsets[i], (image->width * image->height));
+            }
+        }
+    }
+
+    for (i = 0; (i < importedData->numTexturePages) && hasPages; i++)
+    {
+        PLACE_PIXELS(archive->pageOffsets[i], (importedData->texturePages[i].width * importedData->texturePages[i].height));
+    }
+
+    #undef PLACE_PIXELS
+
+    make_output_filename(filename, level, "texture/textures.tra");
+    writer_open(&archive->file, level, filename, archive->buffer, sizeof(archive->buffer));
+
+    /* The offsets are 32-bit.*/
+    if (pos >= TEXTURE_ARCHIVE_NONE)
+    {
+        set_level_error(level, DIG_ERROR_OUTPUT);
+        archive->file.failed = 1;
+    }
+
+    write_bytes(&archive->file, "TRA1", 4);
+    write_le32(&archive->file, numEntries);
+    write_le32(&archive->file, (sizeof(uint32_t) * TEXTURE_ARCHIVE_HEADER_NUM_WORDS));
+    write_le32(&archive->file, TEXTURE_ARCHIVE_ALIGNMENT);
+
+    for (i = 0; (i < importedData->numTextureAtlases) && hasAtlases; i++)
+    {
+        const struct tr_texture_atlas_s *const atlas = &importedData->textureAtlases[i];
+
+        write_le32(&archive->file, TEXTURE_ARCHIVE_ATLAS);
+        write_le32(&archive->file, i);
+        write_le32(&archive->file, atlas->width);
+        write_le32(&archive->file, atlas->height);
+        write_le32(&archive->file, i);
+        write_le32(&archive->file, 0);
+        write_le32(&archive->file, 0);
+        write_le32(&archive->file, 0);
+        write_le32(&archive->file, TEXTURE_ARCHIVE_NONE);
+        write_le32(&archive->file, archive->atlasOffsets[i]);
+    }
+
+    for (i = 0; (i < importedData->numTexturePages) && hasPages; i++)
+    {
+        const struct tr_texture_page_s *const page = &importedData->texturePages[i];
+
+        write_le32(&archive->file, TEXTURE_ARCHIVE_PAGE);
+        write_le32(&archive->file, i);
+        write_le32(&archive->file, page->width);
+        write_le32(&archive->file, page->height);
+        write_le32(&archive->file, TEXTURE_ARCHIVE_NONE);
+        write_le32(&archive->file, 0);
+        write_le32(&archive->file, 0);
+        write_le32(&archive->file, 0);
+        write_le32(&archive->file, TEXTURE_ARCHIVE_NONE);
+        write_le32(&archive->file, archive->pageOffsets[i]);
+    }
+
+    for (i = 0; (i < importedData->numObjectTextures) && !level->repackTextures; i++)
+    {
+        const struct tr_object_texture_s *const texture = &importedData->objectTextures[i];
+        const struct tr_texture_image_s *const image = &importedData->textureImages[texture->imageIdx];
+
+        if (!importedData->objectTextureIsSelected[i])
+        {
+            continue;
+        }
+
+        write_le32(&archive->file, TEXTURE_ARCHIVE_OBJECT_TEXTURE);
+        write_le32(&archive->file, i);
+        write_le32(&archive->file, texture->width);
+        write_le32(&archive->file, texture->height);
+        write_le32(&archive->file, image->atlasIdx);
+        write_le32(&archive->file, image->x);
+        write_le32(&archive->file, image->y);
+        write_le32(&archive->file, ((texture->hasAlpha? TEXTURE_ARCHIVE_HAS_ALPHA : 0) |
+                                    (texture->ignoresDepthTest? TEXTURE_ARCHIVE_IGNORES_DEPTH_TEST : 0) |
+                                    (texture->hasWireframe? TEXTURE_ARCHIVE_HAS_WIREFRAME : 0)));
+        write_le32(&archive->file, texture->imageIdx);
+        write_le32(&archive->file, archive->imageOffsets[texture->imageIdx]);
+    }
+
+    archive->numBytesWritten = (sizeof(uint32_t) * (TEXTURE_ARCHIVE_HEADER_NUM_WORDS + ((size_t)numEntries * TEXTURE_ARCHIVE_ENTRY_NUM_WORDS)));
+
+    return;
+}
+
+/* Writes into the texture archive the given atlas's pixels and those of the
+ * selected texture images cut out of it, which must be in memory. The atlases
+ * are to be written in order of index.*/
+void texture_archive_write_atlas(struct texture_archive_s *const archive,
+                                 const struct level_s *const level,
+                                 const unsigned atlasIdx)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const struct tr_texture_atlas_s *const atlas = &importedData->textureAtlases[atlasIdx];
+    const uint8_t padding[TEXTURE_ARCHIVE_ALIGNMENT] = {0};
+    unsigned i = 0;
+
+    #define WRITE_PIXELS(offset, pixels, numBytes) write_bytes(&archive->file, padding, ((offset) - archive->numBytesWritten));\
+                                                   write_bytes(&archive->file, (pixels), (numBytes));\
+                                                   archive->numBytesWritten = ((offset) + (numBytes));
+
+    if (archive->atlasOffsets[atlasIdx] != TEXTURE_ARCHIVE_NONE)
+    {
+        WRITE_PIXELS(archive->atlasOffsets[atlasIdx], atlas->pixelData, (atlas->width * atlas->height));
+    }
+
+    for (i = 0; i < importedData->numTextureImages; i++)
+    {
+        const struct tr_texture_image_s *const image = &importedData->textureImages[i];
+
+        if ((image->atlasIdx == atlasIdx) &&
+            (archive->imageOffsets[i] != TEXTURE_ARCHIVE_NONE))
+        {
+            WRITE_PIXELS(archive->imageOffsets[i], image->pixelData, (image->width * image->height));
+        }
+    }
+
+    #undef WRITE_PIXELS
+
+    return;
+}
+
+/* Writes into the texture archive the pixels of the texture pages, which must
+ * have had all of the atlases drawn onto them, once all of the atlases have
+ * been written.*/
+void texture_archive_write_pages(struct texture_archive_s *const archive, const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const uint8_t padding[TEXTURE_ARCHIVE_ALIGNMENT] = {0};
+    unsigned i = 0;
+
+    for (i = 0; i < importedData->numTexturePages; i++)
+    {
+        const struct tr_texture_page_s *const page = &importedData->texturePages[i];
+
+        if (archive->pageOffsets[i] != TEXTURE_ARCHIVE_NONE)
+        {
+            write_bytes(&archive->file, padding, (archive->pageOffsets[i] - archive->numBytesWritten));
+            write_bytes(&archive->file, page->pixelData, (page->width * page->height));
+            archive->numBytesWritten = (archive->pageOffsets[i] + (page->width * page->height));
+        }
+    }
+
+    return;
+}
+
+void texture_archive_close(struct texture_archive_s *const archive)
+{
+    writer_close(&archive->file);
+
+    free(archive->atlasOffsets);
+    free(archive->imageOffsets);
+    free(archive->pageOffsets);
+
+    return;
+}
+
+/* Saves the level's texture atlases and selected object textures (or texture
+ * pages) into a texture archive; see texture_archive_open().*/
+void save_texture_archive(const struct level_s *const level)
+{
+    struct texture_archive_s *const archive = malloc(sizeof(struct texture_archive_s));
+    unsigned i = 0;
+
+    assert(archive && "Failed to allocate memory for a texture archive.");
+
+    texture_archive_open(archive, level);
+
+    for (i = 0; i < level->importedData.numTextureAtlases; i++)
+    {
+        texture_archive_write_atlas(archive, level, i);
+    }
+
+    texture_archive_write_pages(archive, level);
+    texture_archive_close(archive);
+    free(archive);
+
+    return;
+}
+
+/* Writes the given faces into a .trm file being written as outFile. Untextured
+ * faces, and those whose texture index is out of range, get UVs of 0.*/
+#define SAVE_ROOM_FACES(numFaces, faceData, vertices, numVertsPerFace, facesAreTextured)\
+        for (j = 0; j < numFaces; j++)\
+        {\
+            const struct tr_object_texture_s *const texture = ((facesAreTextured &&\
+                                                                (faceData[j].textureIdx < importedData->numObjectTextures))?\
+                                                               &importedData->objectTextures[faceData[j].textureIdx]\
+                                                               : NULL);\
+            int v = 0;\
+            \
+            write_int(&outFile, numVertsPerFace);\
+            write_char(&outFile, ' ');\
+            write_int(&outFile, (facesAreTextured? face_texture_idx(importedData, faceData[j].textureIdx)\
+                                                 : -(faceData[j].textureIdx & 0xff)));\
+            \
+            for (v = 0; v < numVertsPerFace; v++)\
+            {\
+                const unsigned vertexIdx = faceData[j].vertexIdx[v];\
+                \
+                write_char(&outFile, ' ');\
+                write_int(&outFile, (vertices)->x[vertexIdx]);\
+                write_char(&outFile, ' ');\
+                write_int(&outFile, (vertices)->y[vertexIdx]);\
+                write_char(&outFile, ' ');\
+                write_int(&outFile, (vertices)->z[vertexIdx]);\
+                write_char(&outFile, ' ');\
+                write_float(&outFile, (texture? texture->u[v] : 0));\
+                write_char(&outFile, ' ');\
+                write_float(&outFile, (texture? texture->v[v] : 0));\
+            }\
+            \
+            write_char(&outFile, '\n');\
+        }
+
+/* Saves the given room's mesh as a .trm file, along with the meshes of its
+ * static objects unless they're exported as instances of the meshes in
+ * mesh/object/.*/
+void save_room_trm(const struct level_s *const level, const unsigned roomIdx)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const struct tr_room_mesh_s *const room = &importedData->roomMeshes[roomIdx];
+    struct output_writer_s outFile;
+    char outputBuffer[OUTPUT_BUFFER_SIZE];
+    char meshFileName[MAX_PATH_LENGTH];
+    unsigned j = 0, p = 0;
+
+    make_output_filename(meshFileName, level, "mesh/room/%d.trm", roomIdx);
+    writer_open(&outFile, level, meshFileName, outputBuffer, sizeof(outputBuffer));
+
+    stats_count_faces(level, (room->numQuads + room->numTriangles));
+
+    SAVE_ROOM_FACES(room->numQuads, room->quads, &room->vertices, 4, 1);
+    SAVE_ROOM_FACES(room->numTriangles, room->triangles, &room->vertices, 3, 1);
+
+    for (p = 0; (p < room->numStaticObjects) && !level->instancedStatics; p++)
+    {
+        const struct tr_mesh_meta_s *const objectMeta = &room->staticObjects[p];
+        const struct tr_mesh_s *const object = &importedData->meshes[objectMeta->meshIdx];
+
+        SAVE_ROOM_FACES(object->numTexturedQuads, object->texturedQuads, &objectMeta->vertices, 4, 1);
+        SAVE_ROOM_FACES(object->numTexturedTriangles, object->texturedTriangles, &objectMeta->vertices, 3, 1);
+        SAVE_ROOM_FACES(object->numUntexturedQuads, object->untexturedQuads, &objectMeta->vertices, 4, 0);
+        SAVE_ROOM_FACES(object->numUntexturedTriangles, object->untexturedTriangles, &objectMeta->vertices, 3, 0);
+
+        stats_count_faces(level, mesh_num_faces(object));
+    }
+
+    writer_close(&outFile);
+
+    return;
+}
+
+/* Saves the given mesh of the master list as a .trm file in mesh/object/, in the
+ * mesh's own coordinates.*/
+void save_object_mesh_trm(const struct level_s *const level, const unsigned meshIdx)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+    const struct tr_mesh_s *const object = &importedData->meshes[meshIdx];
+    struct output_writer_s outFile;
+    char outputBuffer[OUTPUT_BUFFER_SIZE];
+    char meshFileName[MAX_PATH_LENGTH];
+    unsigned j = 0;
+
+    make_output_filename(meshFileName, level, "mesh/object/%d.trm", meshIdx);
+    writer_open(&outFile, level, meshFileName, outputBuffer, sizeof(outputBuffer));
+
+    SAVE_ROOM_FACES(object->numTexturedQuads, object->texturedQuads, &object->vertices, 4, 1);
+    SAVE_ROOM_FACES(object->numTexturedTriangles, object->texturedTriangles, &object->vertices, 3, 1);
+    SAVE_ROOM_FACES(object->numUntexturedQuads, object->untexturedQuads, &object->vertices, 4, 0);
+    SAVE_ROOM_FACES(object->numUntexturedTriangles, object->untexturedTriangles, &object->vertices, 3, 0);
+
+    writer_close(&outFile);
+    stats_count_faces(level, mesh_num_faces(object));
+
+    return;
+}
+
+#undef SAVE_ROOM_FACES
+
+/* Saves the given room's mesh, in the chosen formats of .trb and .obj.*/
+void save_room_trb_obj(const struct level_s *const level, const unsigned roomIdx)
+{
+    unsigned numFaces = 0;
+    struct export_face_s *const faces = collect_room_faces(level, roomIdx, &numFaces);
+
+    stats_count_faces(level, numFaces);
+
+    if (level->meshFormats & MESH_FORMAT_TRB) save_mesh_trb(level, "mesh/room/", roomIdx, faces, numFaces);
+    if (level->meshFormats & MESH_FORMAT_OBJ) save_mesh_obj(level, "mesh/room/", roomIdx, faces, numFaces);
+
+    free(faces);
+
+    return;
+}
+
+/* Saves the given mesh of the master list into mesh/object/, in the chosen
+ * formats of .trb and .obj.*/
+void save_object_mesh_trb_obj(const struct level_s *const level, const unsigned meshIdx)
+{
+    unsigned numFaces = 0;
+    struct export_face_s *const faces = collect_object_mesh_faces(&level->importedData, meshIdx, &numFaces);
+
+    stats_count_faces(level, numFaces);
+
+    if (level->meshFormats & MESH_FORMAT_TRB) save_mesh_trb(level, "mesh/object/", meshIdx, faces, numFaces);
+    if (level->meshFormats & MESH_FORMAT_OBJ) save_mesh_obj(level, "mesh/object/", meshIdx, faces, numFaces);
+
+    free(faces);
+
+    return;
+}
+
+/* Returns how many textures are exported after the texture atlases: the texture
+ * pages, unique texture images or object textures, depending on the options.*/
+unsigned num_exported_textures(const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+
+    return (level->repackTextures? importedData->numTexturePages :
+            level->dedupTextures? importedData->numTextureImages :
+            importedData->numObjectTextures);
+}
+
+/* Saves the level's texture atlases followed by its object textures (or, when
+ * deduplicating textures, its unique texture images; or when repacking them,
+ * its texture pages) in the chosen raw formats, one texture per task.*/
+void save_raw_texture_task(void *const context, const unsigned taskIdx)
+{
+    const struct level_s *const level = context;
+    const struct imported_data_s *const importedData = &level->importedData;
+
+    if (taskIdx < importedData->numTextureAtlases)
+    {
+        const struct tr_texture_atlas_s *const atlas = &importedData->textureAtlases[taskIdx];
+
+        if (level->exportParts & EXPORT_TEXTURE_ATLASES)
+        {
+            save_raw_texture(level, "texture/atlas/", taskIdx, atlas->width, atlas->height, atlas->pixelData);
+        }
+    }
+    else if (level->repackTextures)
+    {
+        const unsigned pageIdx = (taskIdx - importedData->numTextureAtlases);
+        const struct tr_texture_page_s *const page = &importedData->texturePages[pageIdx];
+
+        if (level->exportParts & EXPORT_OBJECT_TEXTURES)
+        {
+            save_raw_texture(level, "texture/page/", pageIdx, page->width, page->height, page->pixelData);
+        }
+    }
+    else if (level->dedupTextures)
+    {
+        const unsigned imageIdx = (taskIdx - importedData->numTextureAtlases);
+        const struct tr_texture_image_s *const image = &importedData->textureImages[imageIdx];
+
+        if (importedData->textureImageIsSelected[imageIdx])
+        {
+            save_raw_texture(level, "texture/image/", imageIdx, image->width, image->height, image->pixelData);
+        }
+    }
+    else
+    {
+        const unsigned textureIdx = (taskIdx - importedData->numTextureAtlases);
+        const struct tr_object_texture_s *const texture = &importedData->objectTextures[textureIdx];
+
+        if (importedData->objectTextureIsSelected[textureIdx])
+        {
+            save_raw_texture(level, "texture/object/", textureIdx, texture->width, texture->height, texture->pixelData);
+        }
+    }
+
+    return;
+}
+
+/* Saves the given texture, as indexed by save_raw_texture_task(), in the chosen
+ * formats.*/
+void save_texture(const struct level_s *const level, const unsigned textureIdx)
+{
+    if (level->textureFormats & RAW_TEXTURE_FORMATS)
+    {
+        save_raw_texture_task((void*)level, textureIdx);
+    }
+
+    if (level->textureFormats & PNG_TEXTURE_FORMATS)
+    {
+        save_texture_png_task((void*)level, textureIdx);
+    }
+
+    return;
+}
+
+/* Returns the number of tasks for save_texture_batch_task().*/
+unsigned num_texture_batches(const struct level_s *const level)
+{
+    const unsigned numTextures = num_exported_textures(level);
+
+    return (level->importedData.numTextureAtlases + ((numTextures + EXPORT_TEXTURES_PER_TASK - 1) / EXPORT_TEXTURES_PER_TASK));
+}
+
+/* Saves the level's texture atlases, one per task, followed by its object
+ * textures (or unique texture images, or texture pages), EXPORT_TEXTURES_PER_TASK
+ * per task.*/
+void save_texture_batch_task(void *const context, const unsigned taskIdx)
+{
+    const struct level_s *const level = context;
+    const struct imported_data_s *const importedData = &level->importedData;
+    const unsigned numTextures = num_exported_textures(level);
+    unsigned first = 0, last = 0, i = 0;
+
+    if (taskIdx < importedData->numTextureAtlases)
+    {
+        save_texture(level, taskIdx);
+        return;
+    }
+
+    first = (importedData->numTextureAtlases + ((taskIdx - importedData->numTextureAtlases) * EXPORT_TEXTURES_PER_TASK));
+    last = (importedData->numTextureAtlases + numTextures);
+
+    for (i = first; (i < (first + EXPORT_TEXTURES_PER_TASK)) && (i < last); i++)
+    {
+        save_texture(level, i);
+    }
+
+    return;
+}
+
+/* Saves the given room's mesh in the chosen formats, along with the list of its
+ * static objects if they're exported as instances.*/
+void save_room(const struct level_s *const level, const unsigned roomIdx)
+{
+    if (level->meshFormats & MESH_FORMAT_TRM) save_room_trm(level, roomIdx);
+    if (level->meshFormats & (MESH_FORMAT_TRB | MESH_FORMAT_OBJ)) save_room_trb_obj(level, roomIdx);
+    if (level->instancedStatics) save_room_instances(level, roomIdx);
+
+    return;
+}
+
+/* Saves the given mesh of the master list into mesh/object/ in the chosen formats,
+ * if it's used by the selected rooms' static objects.*/
+void save_object_mesh_task(void *const context, const unsigned meshIdx)
+{
+    const struct level_s *const level = context;
+
+    if (!level->importedData.meshIsSelected[meshIdx])
+    {
+        return;
+    }
+
+    if (level->meshFormats & MESH_FORMAT_TRM) save_object_mesh_trm(level, meshIdx);
+    if (level->meshFormats & (MESH_FORMAT_TRB | MESH_FORMAT_OBJ)) save_object_mesh_trb_obj(level, meshIdx);
+
+    return;
+}
+
+/* Saves the level's selected rooms followed by (when the static objects are
+ * exported as instances) the meshes of the master list, one per task.*/
+void save_mesh_task(void *const context, const unsigned taskIdx)
+{
+    const struct level_s *const level = context;
+    const struct imported_data_s *const importedData = &level->importedData;
+
+    if (taskIdx < importedData->numRoomMeshes)
+    {
+        if (importedData->roomIsSelected[taskIdx])
+        {
+            save_room(level, taskIdx);
+        }
+    }
+    else
+    {
+        save_object_mesh_task(context, (taskIdx - importedData->numRoomMeshes));
+    }
+
+    return;
+}
+
+/* Exports the imported level. Each room, mesh and texture is saved into files
+ * of its own, so they're spread over the level's threads as independent tasks;
+ * which files are written, and what into them, doesn't depend on the order in
+ * which the tasks run.*/
+void export_imported_data(const struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+
+    /* Save the level's palette.*/
+    {
+        char filename[MAX_PATH_LENGTH];
+
+        stats_begin_phase(level, "export palette");
+
+        make_output_filename(filename, level, "texture/palette.pal");
+        save_output_file(level, filename, importedData->palette, 768);
+
+        stats_end_phase(level, 0);
+    }
+
+    /* Save textures.*/
+    {
+        stats_begin_phase(level, "export textures");
+
+        if (level->textureFormats & (RAW_TEXTURE_FORMATS | PNG_TEXTURE_FORMATS))
+        {
+            run_parallel_tasks(num_texture_batches(level), save_texture_batch_task, (void*)level, level->numThreads);
+        }
+
+        if ((level->exportParts & EXPORT_OBJECT_TEXTURES) && level->dedupTextures)
+        {
+            save_texture_image_index(level);
+        }
+
+        if ((level->textureFormats & TEXTURE_FORMAT_ARCHIVE) &&
+            (level->exportParts & (EXPORT_TEXTURE_ATLASES | EXPORT_OBJECT_TEXTURES)))
+        {
+            save_texture_archive(level);
+        }
+
+        stats_end_phase(level, 0);
+    }
+
+    /* Save the selected room meshes, and the meshes of their static objects once
+     * each if the objects are exported as instances.*/
+    if (level->exportParts & EXPORT_ROOM_MESHES)
+    {
+        const unsigned numMeshTasks = (importedData->numRoomMeshes + (level->instancedStatics? importedData->numMeshes : 0));
+
+        stats_begin_phase(level, "export meshes");
+
+        if (level->meshFormats & (MESH_FORMAT_TRM | MESH_FORMAT_TRB | MESH_FORMAT_OBJ))
+        {
+            run_parallel_tasks(numMeshTasks, save_mesh_task, (void*)level, level->numThreads);
+        }
+
+        stats_end_phase(level, 0);
+
+        /* The .glb file holds the whole level, so it's built on one thread.*/
+        stats_begin_phase(level, "export glb");
+
+        if (level->meshFormats & MESH_FORMAT_GLB)
+        {
+            save_level_glb(level);
+        }
+
+        stats_end_phase(level, 0);
+    }
+
+    return;
+}
+
+/* A batch of consecutive rooms being decoded and exported in streaming mode.*/
+struct room_stream_context_s
+{
+    struct level_s *level;
+    unsigned firstRoomIdx;
+
+    /* Map the rooms' static objects to the master list of meshes; see
+     * load_static_mesh_table().*/
+    const struct weld_table_s *staticMeshIds;
+    const unsigned *meshIdxs;
+};
+
+/* Decodes and exports one room of a batch in streaming mode.*/
+void stream_room_task(void *const context, const unsigned taskIdx)
+{
+    const struct room_stream_context_s *const stream = context;
+    struct level_s *const level = stream->level;
+    const unsigned roomIdx = (stream->firstRoomIdx + taskIdx);
+
+    if (!level->importedData.roomIsSelected[roomIdx])
+    {
+        return;
+    }
+
+    decode_room(level, roomIdx, &level->toc.rooms[roomIdx]);
+    resolve_static_objects(level, roomIdx, stream->staticMeshIds, stream->meshIdxs);
+
+    if (static_objects_need_placing(level))
+    {
+        place_static_objects_task(level, roomIdx);
+    }
+
+    if (level->exportParts & EXPORT_ROOM_MESHES)
+    {
+        save_room(level, roomIdx);
+    }
+
+    return;
+}
+
+/* Decodes and exports the level's selected rooms in streaming mode, a batch at
+ * a time, releasing each batch's geometry (and the level file's pages that it
+ * was decoded from) before moving on to the next. Selects the object textures
+ * that the rooms use, if only the textures of the selected rooms are to be
+ * exported.*/
+void stream_rooms(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    const struct room_index_s *const roomIndex = level->toc.rooms;
+    const unsigned batchSize = (level->numThreads * STREAM_ROOMS_PER_THREAD);
+    struct room_stream_context_s stream;
+    struct weld_table_s staticMeshIds;
+    struct arena_s batchArena;
+    uint64_t numBytesRead = 0;
+    unsigned i = 0;
+
+    stats_begin_phase(level, "stream rooms");
+
+    arena_init(&batchArena);
+    level->roomArena = &batchArena;
+
+    stream.level = level;
+    stream.staticMeshIds = &staticMeshIds;
+    stream.meshIdxs = load_static_mesh_table(level, &staticMeshIds);
+
+    for (stream.firstRoomIdx = 0;
+         (stream.firstRoomIdx < importedData->numRoomMeshes) && (level_error(level) == DIG_OK);
+         stream.firstRoomIdx += batchSize)
+    {
+        const unsigned numRooms = (((importedData->numRoomMeshes - stream.firstRoomIdx) < batchSize)?
+                                   (importedData->numRoomMeshes - stream.firstRoomIdx) : batchSize);
+        const struct room_index_s *const lastRoom = &roomIndex[stream.firstRoomIdx + numRooms - 1];
+        const size_t batchStart = roomIndex[stream.firstRoomIdx].roomDataOffset;
+        const size_t batchEnd = (lastRoom->staticObjectsOffset + (lastRoom->numStaticObjects * SIZE_TR_ROOM_STATIC_MESH));
+
+        run_parallel_tasks(numRooms, stream_room_task, &stream, level->numThreads);
+
+        for (i = stream.firstRoomIdx; i < (stream.firstRoomIdx + numRooms); i++)
+        {
+            if (!importedData->roomIsSelected[i])
+            {
+                continue;
+            }
+
+            if (level->roomList && (level->exportParts & EXPORT_OBJECT_TEXTURES))
+            {
+                select_room_textures(level, i);
+            }
+
+            numBytesRead += ((roomIndex[i].numRoomDataWords * 2) + (roomIndex[i].numStaticObjects * SIZE_TR_ROOM_STATIC_MESH));
+            memset(&importedData->roomMeshes[i], 0, sizeof(importedData->roomMeshes[i]));
+        }
+
+        arena_release(&batchArena);
+        arena_init(&batchArena);
+
+        if (batchEnd > batchStart)
+        {
+            release_input_range(level, batchStart, (batchEnd - batchStart));
+        }
+    }
+
+    weld_table_free(&staticMeshIds);
+    free((void*)stream.meshIdxs);
+
+    arena_release(&batchArena);
+    level->roomArena = &level->arena;
+
+    stats_end_phase(level, numBytesRead);
+
+    return;
+}
+
+/* The textures of one texture atlas being exported in streaming mode, as task
+ * indices of save_raw_texture_task() and save_texture_png_task().*/
+struct texture_stream_context_s
+{
+    const struct level_s *level;
+    unsigned *textureIdxs;
+};
+
+void stream_texture_task(void *const context, const unsigned taskIdx)
+{
+    const struct texture_stream_context_s *const stream = context;
+
+    save_texture(stream->level, stream->textureIdxs[taskIdx]);
+
+    return;
+}
+
+/* Exports the level's texture atlases and selected object textures in streaming
+ * mode, one atlas at a time: the atlas, and then the object textures on it,
+ * whose pixels are copied out of the atlas only for as long as they're being
+ * exported.*/
+void stream_textures(struct level_s *const level)
+{
+    struct imported_data_s *const importedData = &level->importedData;
+    const unsigned numTextures = num_exported_textures(level);
+    struct texture_stream_context_s stream;
+    struct texture_archive_s *archive = NULL;
+    struct arena_s pixelArena, pageArena;
+    unsigned atlasIdx = 0, i = 0;
+
+    stats_begin_phase(level, "stream textures");
+
+    stream.level = level;
+    stream.textureIdxs = malloc(sizeof(unsigned) * (numTextures + 1));
+    assert(stream.textureIdxs && "Failed to allocate memory for exporting textures.");
+
+    if ((level->textureFormats & TEXTURE_FORMAT_ARCHIVE) &&
+        (level->exportParts & (EXPORT_TEXTURE_ATLASES | EXPORT_OBJECT_TEXTURES)))
+    {
+        archive = malloc(sizeof(struct texture_archive_s));
+        assert(archive && "Failed to allocate memory for a texture archive.");
+
+        texture_archive_open(archive, level);
+    }
+
+    arena_init(&pixelArena);
+    arena_init(&pageArena);
+
+    if (level->repackTextures)
+    {
+        alloc_texture_pages(level, &pageArena);
+    }
+
+    for (atlasIdx = 0; atlasIdx < importedData->numTextureAtlases; atlasIdx++)
+    {
+        unsigned numAtlasTextures = 0;
+
+        for (i = 0; i < importedData->numTextureImages; i++)
+        {
+            if ((importedData->textureImages[i].atlasIdx == atlasIdx) &&
+                importedData->textureImageIsSelected[i])
+            {
+                copy_texture_image(level, &pixelArena, i);
+            }
+        }
+
+        link_object_texture_pixels(level);
+
+        stream.textureIdxs[numAtlasTextures++] = atlasIdx;
+
+        if (level->repackTextures)
+        {
+            draw_texture_pages(level, atlasIdx);
+        }
+
+        for (i = 0; (i < numTextures) && !level->repackTextures; i++)
+        {
+            const unsigned imageIdx = (level->dedupTextures? i : importedData->objectTextures[i].imageIdx);
+
+            if (importedData->textureImages[imageIdx].atlasIdx == atlasIdx)
+            {
+                stream.textureIdxs[numAtlasTextures++] = (importedData->numTextureAtlases + i);
+            }
+        }
+
+        run_parallel_tasks(numAtlasTextures, stream_texture_task, &stream, level->numThreads);
+
+        if (archive)
+        {
+            texture_archive_write_atlas(archive, level, atlasIdx);
+        }
+
+        for (i = 0; i < importedData->numTextureImages; i++)
+        {
+            importedData->textureImages[i].pixelData = NULL;
+        }
+
+        link_object_texture_pixels(level);
+        arena_release(&pixelArena);
+        arena_init(&pixelArena);
+
+        release_input_range(level, (importedData->textureAtlases[atlasIdx].pixelData - level->inputFile.data),
+                            (importedData->textureAtlases[atlasIdx].width * importedData->textureAtlases[atlasIdx].height));
+    }
+
+    /* The texture pages are complete once all of the atlases have been drawn.*/
+    if (level->repackTextures)
+    {
+        for (i = 0; i < numTextures; i++)
+        {
+            stream.textureIdxs[i] = (importedData->numTextureAtlases + i);
+        }
+
+        run_parallel_tasks(numTextures, stream_texture_task, &stream, level->numThreads);
+
+        if (archive)
+        {
+            texture_archive_write_pages(archive, level);
+        }
+
+        for (i = 0; i < numTextures; i++)
+        {
+            importedData->texturePages[i].pixelData = NULL;
+        }
+    }
+
+    arena_release(&pixelArena);
+    arena_release(&pageArena);
+    free(stream.textureIdxs);
+
+    if (archive)
+    {
+        texture_archive_close(archive);
+        free(archive);
+    }
+
+    if ((level->exportParts & EXPORT_OBJECT_TEXTURES) && level->dedupTextures)
+    {
+        save_texture_image_index(level);
+    }
+
+    stats_end_phase(level, ((uint64_t)importedData->numTextureAtlases * 256 * 256));
+
+    return;
+}
+
+/* Exports the level in streaming mode: rooms, object meshes and textures as
+ * they're decoded, so that only a batch of rooms, or the textures of one atlas,
+ * are in memory at a time. See import_streaming_data_from_input_file().*/
+void stream_level_data(struct level_s *const level)
+{
+    const struct imported_data_s *const importedData = &level->importedData;
+
+    {
+        char filename[MAX_PATH_LENGTH];
+
+        stats_begin_phase(level, "export palette");
+
+        make_output_filename(filename, level, "texture/palette.pal");
+        save_output_file(level, filename, importedData->palette, 768);
+
+        stats_end_phase(level, 0);
+    }
+
+    stream_rooms(level);
+
+    if (level_error(level) != DIG_OK)
+    {
+        return;
+    }
+
+    /* Save the meshes of the selected rooms' static objects, once each.*/
+    stats_begin_phase(level, "export object meshes");
+    if ((level->exportParts & EXPORT_ROOM_MESHES) && level->instancedStatics)
+    {
+        run_parallel_tasks(importedData->numMeshes, save_object_mesh_task, (void*)level, level->numThreads);
+    }
+    stats_end_phase(level, 0);
+
+    select_texture_images(level);
+    stream_textures(level);
+
+    return;
+}
+
+/* Writes the name of the level's table of contents file into the given buffer
+ * of MAX_PATH_LENGTH bytes. Returns 0 if the name doesn't fit.*/
+int make_toc_filename(char *const dst, const struct level_s *const level)
+{
+    const int length = snprintf(dst, MAX_PATH_LENGTH, "%s.digtoc", level->inputFilename);
+
+    return ((length > 0) && (length < MAX_PATH_LENGTH));
+}
+
+/* A table of contents file consists of little-endian 32-bit values, with 64-bit
+ * values given as their low word followed by their high word:
+ *
+ *   header    TOC_FILE_MAGIC, TOC_FILE_VERSION, the level file's size,
+ *             modification time (seconds and nanoseconds), serial number,
+ *             device and sample hash, a hash of the rest of the file (the
+ *             sections and rooms below), and the number of sections
+ *   sections  each section's offset and count, in file order
+ *   rooms     the number of rooms, followed by each room's x, z, room data
+ *             offset, number of room data words, number of vertices, quads
+ *             and triangles, static objects' offset, and number of static
+ *             objects
+ */
+#define TOC_HEADER_NUM_WORDS 17
+#define TOC_ROOM_NUM_WORDS 9
+
+/* Fills in the level's toc with what identifies the level file as it is now:
+ * its size and stat() information, and a hash of the bytes at its start, middle
+ * and end. The samples catch a file being rewritten in place within the
+ * resolution of its modification time, without reading all of it. Returns 0 if
+ * the file can't be stat()'d.*/
+int identify_level_file(struct level_s *const level)
+{
+    struct level_toc_s *const toc = &level->toc;
+    const struct data_cursor_s *const inputFile = &level->inputFile;
+    const size_t sampleSize = ((inputFile->size < TOC_SAMPLE_SIZE)? inputFile->size : TOC_SAMPLE_SIZE);
+    const size_t sampleOffsets[3] = {0, ((inputFile->size - sampleSize) / 2), (inputFile->size - sampleSize)};
+    struct stat fileInfo;
+    unsigned i = 0;
+
+    if (stat(level->inputFilename, &fileInfo) != 0)
+    {
+        return 0;
+    }
+
+    toc->fileSize = inputFile->size;
+    toc->modifiedSeconds = fileInfo.st_mtim.tv_sec;
+    toc->modifiedNanoseconds = fileInfo.st_mtim.tv_nsec;
+    toc->inode = fileInfo.st_ino;
+    toc->device = fileInfo.st_dev;
+    toc->sampleHash = 0;
+
+    for (i = 0; i < 3; i++)
+    {
+        toc->sampleHash = ((toc->sampleHash * 31) + hash_bytes((inputFile->data + sampleOffsets[i]), sampleSize));
+    }
+
+    toc->numBytesSampled = (3 * sampleSize);
+
+    return 1;
+}
+
+/* Returns the next two 32-bit values of the given cursor as the low and high
+ * word of a 64-bit value.*/
+uint64_t read_toc_u64(struct data_cursor_s *const cursor)
+{
+    const uint32_t low = read_value(cursor, 4);
+    const uint32_t high = read_value(cursor, 4);
+
+    return (low | ((uint64_t)high << 32));
+}
+
+/* Returns 1 if the level's table of contents fits the level file: its sections
+ * lie within the file in file order, and its rooms lie in order within the rooms
+ * section, each with counts that index_room() could have read of it. Only the
+ * table is looked at, not the level file's contents.*/
+int validate_level_toc(const struct level_s *const level)
+{
+    const struct level_toc_s *const toc = &level->toc;
+    const uint64_t floorsOffset = toc->sections[LEVEL_SECTION_FLOORS].offset;
+    uint64_t end = 0;
+    unsigned i = 0;
+
+    for (i = 0; i < NUM_LEVEL_SECTIONS; i++)
+    {
+        const uint64_t offset = toc->sections[i].offset;
+
+        if (offset < end)
+        {
+            return 0;
+        }
+
+        end = (offset + ((uint64_t)LEVEL_SECTION_ELEMENT_SIZES[i] * toc->sections[i].count));
+
+        if (end > level->inputFile.size)
+        {
+            return 0;
+        }
+    }
+
+    end = toc->sections[LEVEL_SECTION_ROOMS].offset;
+
+    for (i = 0; i < toc->sections[LEVEL_SECTION_ROOMS].count; i++)
+    {
+        const struct room_index_s *const room = &toc->rooms[i];
+        const uint64_t roomDataEnd = (room->roomDataOffset + ((uint64_t)room->numRoomDataWords * 2));
+        const uint64_t staticObjectsEnd = (room->staticObjectsOffset + ((uint64_t)room->numStaticObjects * SIZE_TR_ROOM_STATIC_MESH));
+
+        /* The counts are 16-bit in the level file, and the room data holds the
+         * vertices, quads and triangles along with the counts of them.*/
+        if ((room->numVertices > 0xffff) ||
+            (room->numQuads > 0xffff) ||
+            (room->numTriangles > 0xffff) ||
+            (room->numStaticObjects > 0xffff) ||
+            (((uint64_t)room->numRoomDataWords * 2) < (6 + (room->numVertices * SIZE_TR_ROOM_VERTEX) +
+                                                        (room->numQuads * SIZE_TR_ROOM_QUAD) +
+                                                        (room->numTriangles * SIZE_TR_ROOM_TRIANGLE))))
+        {
+            return 0;
+        }
+
+        /* The room's info and the size of its data precede the data; its static
+         * objects' count precedes them; and its alternate room and flags follow
+         * them.*/
+        if ((room->roomDataOffset < (end + SIZE_TR_ROOM_INFO + 4)) ||
+            (room->staticObjectsOffset < (roomDataEnd + 2)) ||
+            ((staticObjectsEnd + 4) > floorsOffset))
+        {
+            return 0;
+        }
+
+        end = (staticObjectsEnd + 4);
+    }
+
+    return 1;
+}
+
+/* Loads the level's table of contents from its sidecar file, if there is one,
+ * it was written for the level file as it is now, and it fits the file. The
+ * level's toc must already identify the file. Returns 1 if the table was
+ * loaded.*/
+int load_level_toc(struct level_s *const level)
+{
+    struct level_toc_s *const toc = &level->toc;
+    const size_t sectionsSize = (NUM_LEVEL_SECTIONS * 2 * sizeof(uint32_t));
+    const size_t headerSize = (TOC_HEADER_NUM_WORDS * sizeof(uint32_t));
+    char filename[MAX_PATH_LENGTH];
+    struct data_cursor_s tocFile;
+    uint8_t *fileData = NULL;
+    FILE *inFile = NULL;
+    long fileSize = 0;
+    uint64_t bodyHash = 0;
+    unsigned numRooms = 0;
+    unsigned i = 0;
+    int isValid = 0;
+
+    if (!make_toc_filename(filename, level) ||
+        !(inFile = fopen(filename, "rb")))
+    {
+        return 0;
+    }
+
+    if ((fseek(inFile, 0, SEEK_END) == 0) &&
+        ((fileSize = ftell(inFile)) >= (long)(headerSize + sectionsSize + sizeof(uint32_t))) &&
+        (fseek(inFile, 0, SEEK_SET) == 0) &&
+        (fileData = malloc(fileSize)) &&
+        (fread(fileData, 1, fileSize, inFile) == (size_t)fileSize))
+    {
+        tocFile.data = fileData;
+        tocFile.size = fileSize;
+        tocFile.pos = 0;
+        tocFile.failed = 0;
+
+        isValid = ((memcmp(read_bytes(&tocFile, 4), TOC_FILE_MAGIC, 4) == 0) &&
+                   ((uint32_t)read_value(&tocFile, 4) == TOC_FILE_VERSION) &&
+                   (read_toc_u64(&tocFile) == toc->fileSize) &&
+                   (read_toc_u64(&tocFile) == toc->modifiedSeconds) &&
+                   (read_toc_u64(&tocFile) == toc->modifiedNanoseconds) &&
+                   (read_toc_u64(&tocFile) == toc->inode) &&
+                   (read_toc_u64(&tocFile) == toc->device) &&
+                   (read_toc_u64(&tocFile) == toc->sampleHash));
+
+        if (isValid)
+        {
+            bodyHash = read_toc_u64(&tocFile);
+
+            isValid = (((uint32_t)read_value(&tocFile, 4) == NUM_LEVEL_SECTIONS) &&
+                       (hash_bytes((fileData + headerSize), (fileSize - headerSize)) == bodyHash));
+        }
+
+        if (isValid)
+        {
+            seek_to(&tocFile, (headerSize + sectionsSize));
+            numRooms = read_value(&tocFile, 4);
+
+            isValid = ((size_t)fileSize == (headerSize + sectionsSize + sizeof(uint32_t) +
+                                            ((size_t)numRooms * TOC_ROOM_NUM_WORDS * sizeof(uint32_t))));
+        }
+
+        if (isValid)
+        {
+            seek_to(&tocFile, headerSize);
+
+            for (i = 0; i < NUM_LEVEL_SECTIONS; i++)
+            {
+                toc->sections[i].offset = (uint32_t)read_value(&tocFile, 4);
+                toc->sections[i].count = read_value(&tocFile, 4);
+            }
+
+            isValid = (toc->sections[LEVEL_SECTION_ROOMS].count == numRooms);
+        }
+
+        if (isValid)
+        {
+            skip_num_bytes(&tocFile, 4);
+            toc->rooms = arena_alloc(&level->arena, (sizeof(struct room_index_s) * numRooms));
+
+            for (i = 0; i < numRooms; i++)
+            {
+                struct room_index_s *const room = &toc->rooms[i];
+
+                room->x = read_value(&tocFile, 4);
+                room->z = read_value(&tocFile, 4);
+                room->roomDataOffset = (uint32_t)read_value(&tocFile, 4);
+                room->numRoomDataWords = read_value(&tocFile, 4);
+                room->numVertices = read_value(&tocFile, 4);
+                room->numQuads = read_value(&tocFile, 4);
+                room->numTriangles = read_value(&tocFile, 4);
+                room->staticObjectsOffset = (uint32_t)read_value(&tocFile, 4);
+                room->numStaticObjects = read_value(&tocFile, 4);
+            }
+
+            isValid = validate_level_toc(level);
+        }
+    }
+
+    free(fileData);
+    fclose(inFile);
+
+    return isValid;
+}
+
+/* Saves the level's table of contents into its sidecar file. Failing to do so
+ * (e.g. because the level's directory is read-only) isn't an error; the level
+ * will just have to be walked through again the next time.*/
+void save_level_toc(const struct level_s *const level)
+{
+    const struct level_toc_s *const toc = &level->toc;
+    const unsigned numRooms = toc->sections[LEVEL_SECTION_ROOMS].count;
+    const size_t numWords = (TOC_HEADER_NUM_WORDS + (NUM_LEVEL_SECTIONS * 2) + 1 + (numRooms * TOC_ROOM_NUM_WORDS));
+    const size_t headerSize = (TOC_HEADER_NUM_WORDS * sizeof(uint32_t));
+    char filename[MAX_PATH_LENGTH], tmpFilename[MAX_PATH_LENGTH + 4];
+    uint8_t *fileData = NULL;
+    uint8_t *dst = NULL;
+    FILE *outFile = NULL;
+    unsigned i = 0;
+
+    if (!make_toc_filename(filename, level))
+    {
+        return;
+    }
+
+    fileData = malloc(numWords * sizeof(uint32_t));
+    assert(fileData && "Failed to allocate memory for the table of contents.");
+
+    /* The header's hash of the body is filled in once the body has been written.*/
+    dst = (fileData + headerSize);
+
+    for (i = 0; i < NUM_LEVEL_SECTIONS; i++)
+    {
+        put_le32(dst, toc->sections[i].offset); dst += 4;
+        put_le32(dst, toc->sections[i].count); dst += 4;
+    }
+
+    put_le32(dst, numRooms); dst += 4;
+
+    for (i = 0; i < numRooms; i++)
+    {
+        const struct room_index_s *const room = &toc->rooms[i];
+
+        put_le32(dst, room->x); dst += 4;
+        put_le32(dst, room->z); dst += 4;
+        put_le32(dst, room->roomDataOffset); dst += 4;
+        put_le32(dst, room->numRoomDataWords); dst += 4;
+        put_le32(dst, room->numVertices); dst += 4;
+        put_le32(dst, room->numQuads); dst += 4;
+        put_le32(dst, room->numTriangles); dst += 4;
+        put_le32(dst, room->staticObjectsOffset); dst += 4;
+        put_le32(dst, room->numStaticObjects); dst += 4;
+    }
+
+    assert(((size_t)(dst - fileData) == (numWords * sizeof(uint32_t))) && "Malformed table of contents.");
+
+    {
+        const uint64_t headerValues[] = {toc->fileSize, toc->modifiedSeconds, toc->modifiedNanoseconds, toc->inode,
+                                         toc->device, toc->sampleHash, hash_bytes((fileData + headerSize), (dst - fileData - headerSize))};
+        uint8_t *header = fileData;
+
+        memcpy(header, TOC_FILE_MAGIC, 4); header += 4;
+        put_le32(header, TOC_FILE_VERSION); header += 4;
+
+        for (i = 0; i < (sizeof(headerValues) / sizeof(headerValues[0])); i++)
+        {
+            put_le32(header, (uint32_t)headerValues[i]); header += 4;
+            put_le32(header, (uint32_t)(headerValues[i] >> 32)); header += 4;
+        }
+
+        put_le32(header, NUM_LEVEL_SECTIONS); header += 4;
+
+        assert(((size_t)(header - fileData) == headerSize) && "Malformed table of contents.");
+    }
+
+    /* Write into a temporary file first, so that a table of contents is never
+     * seen half-written.*/
+    snprintf(tmpFilename, sizeof(tmpFilename), "%s.tmp", filename);
+
+    if ((outFile = fopen(tmpFilename, "wb")))
+    {
+        const size_t numWritten = fwrite(fileData, 1, (dst - fileData), outFile);
+
+        if ((fclose(outFile) != 0) ||
+            (numWritten != (size_t)(dst - fileData)) ||
+            (rename(tmpFilename, filename) != 0))
+        {
+            remove(tmpFilename);
+        }
+    }
+
+    free(fileData);
+
+    return;
+}
+
+/* Walks through the level file to find its sections, and if so asked, saves
+ * them into the file's table of contents; the level's toc must then already
+ * identify the file.*/
+void index_and_save_level_sections(struct level_s *const level, const unsigned saveToc)
+{
+    level->toc.isLoaded = 0;
+
+    index_level_file(level);
+
+    if (saveToc && (level_error(level) == DIG_OK))
+    {
+        save_level_toc(level);
+    }
+
+    return;
+}
+
+/* Finds out where the level file's sections are: from the file's table of
+ * contents if there's an up-to-date one, otherwise by walking through the file
+ * (and then saving a table of contents for the next time).*/
+void locate_level_sections(struct level_s *const level)
+{
+    const unsigned isIdentified = (level->useToc && identify_level_file(level));
+
+    if (isIdentified && load_level_toc(level))
+    {
+        level->toc.isLoaded = 1;
+
+        if (level->verbose)
+        {
+            printf("Using the level's table of contents.\n");
+        }
+
+        return;
+    }
+
+    index_and_save_level_sections(level, isIdentified);
+
+    return;
+}
+
+/* Creates the given directory and any missing parent directories of it. Returns
+ * DIG_OK, or DIG_ERROR_OUTPUT if a directory couldn't be created.*/
+int create_directory_path(const char *const path)
+{
+    char partialPath[MAX_PATH_LENGTH];
+    unsigned i = 0;
+
+    assert((strlen(path) < sizeof(partialPath)) && "Output path is too long.");
+
+    for (i = 0; path[i]; i++)
+    {
+        partialPath[i] = path[i];
+        partialPath[i+1] = '\0';
+
+        if (((path[i] == '/') || !path[i+1]) && (i > 0))
+        {
+            if ((mkdir(partialPath, 0755) != 0) && (errno != EEXIST))
+            {
+                return DIG_ERROR_OUTPUT;
+            }
+        }
+    }
+
+    return DIG_OK;
+}
+
+void create_output_directories(const struct level_s *const level)
+{
+    const char *const subdirectories[] = {"texture/", "mesh/room/", "texture/atlas/", "texture/object/", "texture/image/", "mesh/object/",
+                                          "texture/page/"};
+    unsigned i = 0;
+
+    for (i = 0; i < (sizeof(subdirectories) / sizeof(subdirectories[0])); i++)
+    {
+        char path[MAX_PATH_LENGTH];
+
+        /* Only create the directories of the parts being exported. Object
+         * textures go into one of their directories.*/
+        if (((i == 1) && !(level->exportParts & EXPORT_ROOM_MESHES)) ||
+            ((i == 2) && !(level->exportParts & EXPORT_TEXTURE_ATLASES)) ||
+            ((i == 3) && (!(level->exportParts & EXPORT_OBJECT_TEXTURES) || level->dedupTextures || level->repackTextures)) ||
+            ((i == 4) && (!(level->exportParts & EXPORT_OBJECT_TEXTURES) || !level->dedupTextures)) ||
+            ((i == 5) && (!(level->exportParts & EXPORT_ROOM_MESHES) || !level->instancedStatics)) ||
+            ((i == 6) && (!(level->exportParts & EXPORT_OBJECT_TEXTURES) || !level->repackTextures)))
+        {
+            continue;
+        }
+
+        make_output_filename(path, level, "%s", subdirectories[i]);
+
+        if (create_directory_path(path) != DIG_OK)
+        {
+            set_level_error(level, DIG_ERROR_OUTPUT);
+            return;
+        }
+    }
+
+    return;
+}
+
+/* Exports the level's imported data, or in streaming mode, decodes and exports
+ * the rest of the level's data.*/
+void export_level_data(struct level_s *const level)
+{
+    if (level->streaming)
+    {
+        stream_level_data(level);
+    }
+    else
+    {
+        export_imported_data(level);
+    }
+
+    return;
+}
+
+/* Returns the peak resident set size of the process so far, in bytes.*/
+uint64_t peak_resident_bytes(void)
+{
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    /* Linux gives the size in kilobytes.*/
+    return ((uint64_t)usage.ru_maxrss * 1024);
+}
+
+void dig_default_options(struct dig_options_s *const options)
+{
+    memset(options, 0, sizeof(*options));
+
+    options->numThreads = num_cpu_cores();
+    options->meshFormats = MESH_FORMAT_TRM;
+    options->textureFormats = TEXTURE_FORMAT_TRT;
+    options->exportParts = (EXPORT_ROOM_MESHES | EXPORT_TEXTURE_ATLASES | EXPORT_OBJECT_TEXTURES);
+    options->useToc = 1;
+
+    return;
+}
+
+/* Creates a context for a level to be opened with the given options. Returns
+ * NULL if the options are invalid.*/
+struct dig_level_s* create_level_context(const char *const inputFilename, const struct dig_options_s *const options)
+{
+    struct dig_level_s *ctx = NULL;
+    struct level_s *level = NULL;
+
+    if ((options->roomList && (parse_index_list(options->roomList, NULL, 0) < 0)) ||
+        ((options->textureFormats & TEXTURE_FORMAT_PNG) && (options->textureFormats & TEXTURE_FORMAT_PNG_RGBA)) ||
+        (options->streaming && (options->meshFormats & MESH_FORMAT_GLB)) ||
+        (options->repackTextures && options->dedupTextures))
+    {
+        return NULL;
+    }
+
+    ctx = calloc(1, sizeof(*ctx));
+    assert(ctx && "Failed to allocate memory for the level.");
+
+    ctx->inputFilename = strdup(inputFilename);
+    assert(ctx->inputFilename && "Failed to allocate memory for the level.");
+
+    if (options->roomList)
+    {
+        ctx->roomList = strdup(options->roomList);
+        assert(ctx->roomList && "Failed to allocate memory for the level.");
+    }
+
+    pthread_mutex_init(&ctx->error.lock, NULL);
+    pthread_mutex_init(&ctx->stats.lock, NULL);
+
+    level = &ctx->level;
+    level->inputFilename = ctx->inputFilename;
+    level->roomList = ctx->roomList;
+    level->numThreads = (options->numThreads? options->numThreads : 1);
+    level->meshFormats = options->meshFormats;
+    level->textureFormats = options->textureFormats;
+    level->exportParts = options->exportParts;
+    level->dedupTextures = options->dedupTextures;
+    level->repackTextures = options->repackTextures;
+    level->instancedStatics = options->instancedStatics;
+    level->useToc = options->useToc;
+    level->incremental = options->incremental;
+    level->streaming = options->streaming;
+    level->verbose = options->verbose;
+    level->stats = (options->collectStats? &ctx->stats : NULL);
+    level->error = &ctx->error;
+
+    arena_init(&level->arena);
+    level->roomArena = &level->arena;
+
+    return ctx;
+}
+
+/* Imports the level's data, once its sections have been located; up front, or
+ * in streaming mode, only what's needed before the export.*/
+void import_level_data(struct level_s *const level)
+{
+    if (level->streaming) import_streaming_data_from_input_file(level);
+    else import_data_from_input_file(level);
+
+    return;
+}
+
+/* A table of contents can fit the level file and still be wrong about it, e.g.
+ * if it was edited by hand. If the data that a loaded table led to turned out
+ * malformed, this finds the sections anew, replacing the table for next time,
+ * and imports the level's data over again.*/
+void reimport_level_context(struct dig_level_s *const ctx)
+{
+    struct level_s *const level = &ctx->level;
+
+    assert(level->toc.isLoaded && "Reimporting a level that wasn't imported by its table of contents.");
+
+    arena_release(&level->arena);
+    arena_init(&level->arena);
+    memset(&level->importedData, 0, sizeof(level->importedData));
+    ctx->error.code = DIG_OK;
+
+    stats_begin_phase(level, "sections");
+    index_and_save_level_sections(level, 1);
+    stats_end_phase(level, level->inputFile.pos);
+
+    if (level_error(level) == DIG_OK)
+    {
+        import_level_data(level);
+    }
+
+    return;
+}
+
+/* Finds the sections of the context's level file, which must be in place as its
+ * input, and imports the level's data. Returns DIG_OK, or the first error that
+ * occurred, in which case the context is closed.*/
+int import_level_context(struct dig_level_s **const dst, struct dig_level_s *const ctx, const double startTime)
+{
+    struct level_s *const level = &ctx->level;
+    int error = DIG_OK;
+
+    stats_begin_phase(level, "sections");
+    locate_level_sections(level);
+    stats_end_phase(level, (level->toc.numBytesSampled + level->inputFile.pos));
+
+    if (level_error(level) == DIG_OK)
+    {
+        import_level_data(level);
+    }
+
+    if ((level_error(level) == DIG_ERROR_MALFORMED) && level->toc.isLoaded)
+    {
+        reimport_level_context(ctx);
+    }
+
+    ctx->stats.report.fileSize = level->inputFile.size;
+    ctx->stats.report.seconds += (wall_clock_seconds() - startTime);
+    ctx->stats.report.peakResidentBytes = peak_resident_bytes();
+
+    if ((error = level_error(level)) != DIG_OK)
+    {
+        dig_close(ctx);
+        return error;
+    }
+
+    *dst = ctx;
+
+    return DIG_OK;
+}
+
+int dig_open_file(struct dig_level_s **const level, const char *const filename, const struct dig_options_s *const options)
+{
+    const double startTime = wall_clock_seconds();
+    struct dig_level_s *ctx = NULL;
+
+    *level = NULL;
+
+    if (strlen(filename) >= MAX_PATH_LENGTH)
+    {
+        return DIG_ERROR_ARGUMENT;
+    }
+
+    if (!(ctx = create_level_context(filename, options)))
+    {
+        return DIG_ERROR_ARGUMENT;
+    }
+
+    if (map_input_file(&ctx->level.inputFile, filename) != DIG_OK)
+    {
+        dig_close(ctx);
+        return DIG_ERROR_INPUT;
+    }
+
+    ctx->level.isMapped = 1;
+
+    return import_level_context(level, ctx, startTime);
+}
+
+int dig_open_stream(struct dig_level_s **const level,
+                    const int fd,
+                    const char *const name,
+                    const struct dig_options_s *const options)
+{
+    const double startTime = wall_clock_seconds();
+    struct dig_level_s *ctx = NULL;
+
+    *level = NULL;
+
+    if (!(ctx = create_level_context((name? name : "(stream)"), options)))
+    {
+        return DIG_ERROR_ARGUMENT;
+    }
+
+    /* There's no file next to which to keep a table of contents.*/
+    ctx->level.useToc = 0;
+
+    if (spill_input_fd(&ctx->level.inputFile, fd) != DIG_OK)
+    {
+        dig_close(ctx);
+        return DIG_ERROR_INPUT;
+    }
+
+    ctx->level.isMapped = 1;
+
+    return import_level_context(level, ctx, startTime);
+}
+
+int dig_open_memory(struct dig_level_s **const level,
+                    const void *const data,
+                    const size_t numBytes,
+                    const char *const name,
+                    const struct dig_options_s *const options)
+{
+    const double startTime = wall_clock_seconds();
+    struct dig_level_s *ctx = NULL;
+
+    *level = NULL;
+
+    if (!data || !numBytes)
+    {
+        return DIG_ERROR_ARGUMENT;
+    }
+
+    if (!(ctx = create_level_context((name? name : "(memory)"), options)))
+    {
+        return DIG_ERROR_ARGUMENT;
+    }
+
+    /* There's no file next to which to keep a table of contents.*/
+    ctx->level.useToc = 0;
+
+    ctx->level.inputFile.data = data;
+    ctx->level.inputFile.size = numBytes;
+    ctx->level.inputFile.pos = 0;
+    ctx->level.inputFile.failed = 0;
+
+    return import_level_context(level, ctx, startTime);
+}
+
+/* Exports the level's data into its output path, and in incremental mode,
+ * updates the output's manifest.*/
+void export_level_files(struct level_s *const level)
+{
+    if (level->incremental)
+    {
+        struct output_manifest_s manifest;
+
+        manifest_init(&manifest);
+        level->manifest = &manifest;
+
+        stats_begin_phase(level, "load manifest");
+        load_manifest(level);
+        stats_end_phase(level, 0);
+
+        export_level_data(level);
+
+        /* A manifest saved after a failed export would claim files that weren't
+         * written.*/
+        if (level_error(level) == DIG_OK)
+        {
+            stats_begin_phase(level, "save manifest");
+            save_manifest(level);
+            stats_end_phase(level, 0);
+        }
+
+        level->manifest = NULL;
+        manifest_free(&manifest);
+    }
+    else
+    {
+        export_level_data(level);
+    }
+
+    return;
+}
+
+int dig_export(struct dig_level_s *const ctx, const char *const outputPath)
+{
+    const double startTime = wall_clock_seconds();
+    struct level_s *const level = &ctx->level;
+    const size_t pathLength = strlen(outputPath);
+
+    /* Leave room for the names of the output files under the path.*/
+    if (!pathLength ||
+        ((pathLength + 64) >= MAX_PATH_LENGTH))
+    {
+        return DIG_ERROR_ARGUMENT;
+    }
+
+    sprintf(level->outputPath, "%s%s", outputPath, ((outputPath[pathLength-1] == '/')? "" : "/"));
+
+    ctx->error.code = DIG_OK;
+
+    create_output_directories(level);
+
+    if (level_error(level) != DIG_OK)
+    {
+        return level_error(level);
+    }
+
+    export_level_files(level);
+
+    /* In streaming mode, the rooms are only decoded as they're exported, so it
+     * may only now turn out that the level's table of contents was wrong.*/
+    if ((level_error(level) == DIG_ERROR_MALFORMED) && level->toc.isLoaded)
+    {
+        reimport_level_context(ctx);
+
+        if (level_error(level) == DIG_OK)
+        {
+            export_level_files(level);
+        }
+    }
+
+    ctx->stats.report.seconds += (wall_clock_seconds() - startTime);
+    ctx->stats.report.peakResidentBytes = peak_resident_bytes();
+
+    return level_error(level);
+}
+
+const struct dig_stats_s* dig_stats(const struct dig_level_s *const ctx)
+{
+    return (ctx->level.stats? &ctx->stats.report : NULL);
+}
+
+void dig_close(struct dig_level_s *const ctx)
+{
+    if (!ctx)
+    {
+        return;
+    }
+
+    arena_release(&ctx->level.arena);
+
+    if (ctx->level.isMapped)
+    {
+        unmap_input_file(&ctx->level.inputFile);
+    }
+
+    pthread_mutex_destroy(&ctx->error.lock);
+    pthread_mutex_destroy(&ctx->stats.lock);
+    free(ctx->inputFilename);
+    free(ctx->roomList);
+    free(ctx);
+
+    return;
+}
+
+const char* dig_error_string(const int error)
+{
+    switch (error)
+    {
+        case DIG_OK: return "No error";
+        case DIG_ERROR_INPUT: return "Could not open or read the level file";
+        case DIG_ERROR_MALFORMED: return "Not a valid Tomb Raider 1 level file";
+        case DIG_ERROR_OUTPUT: return "Could not create or write an output file";
+        case DIG_ERROR_ARGUMENT: return "Invalid option or argument";
+        default: return "Unknown error";
+    }
+}
@@ -0,0 +1,215 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft
+ *
+ * Software: libdig
+ *
+ *
+ * Imports Tomb Raider 1 PHD level files and exports their meshes and textures.
+ * The dig command-line program (dig.c) is built on this library.
+ *
+ * A level is opened, from a file or from memory, into a context that holds all
+ * of its imported data; the context can then be exported any number of times,
+ * and is finally closed. Contexts share no state with each other, so separate
+ * levels can be opened and exported concurrently on separate threads. A single
+ * context mustn't be used by more than one thread at a time. The library spreads
+ * the work on each context over the number of threads given in its options.
+ *
+ * The functions return DIG_OK on success or a DIG_ERROR_x value on failure. An
+ * error while opening a level leaves no context behind, and an error while
+ * exporting leaves the context open. Running out of memory isn't reported as an
+ * error; it's fatal to the process.
+ *
+ * A level is exported into the following directory structure, under the given
+ * output path:
+ *
+ *   output path
+ *   |
+ *   +- mesh
+ *   |  |
+ *   |  +- room
+ *   |  |
+ *   |  +- object (with instancedStatics)
+ *   |
+ *   +- texture
+ *      |
+ *      +- atlas
+ *      |
+ *      +- object (or image, with dedupTextures; or page, with repackTextures)
+ *
+ * Build the library and the dig program with e.g.
+ *
+ *   gcc -O2 -pthread -o dig dig.c libdig.c
+ *
+ */
+
+#ifndef LIBDIG_H
+#define LIBDIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Paths (of level files and output files) can be at most this long.*/
+#define MAX_PATH_LENGTH 1024
+
+/* Formats into which room meshes can be exported.*/
+#define MESH_FORMAT_TRM (1 << 0) /* Text; each face with its own copy of its vertices.*/
+#define MESH_FORMAT_TRB (1 << 1) /* Binary; indexed, with shared vertices.*/
+#define MESH_FORMAT_OBJ (1 << 2) /* Wavefront .obj, with an .mtl material library.*/
+#define MESH_FORMAT_GLB (1 << 3) /* glTF 2.0 binary; the whole level in one file.*/
+
+/* Formats into which textures can be exported.*/
+#define TEXTURE_FORMAT_TRT (1 << 0)      /* Raw palette indices, with a .trt.mta size file.*/
+#define TEXTURE_FORMAT_PNG (1 << 1)      /* Indexed-color PNG.*/
+#define TEXTURE_FORMAT_PNG_RGBA (1 << 2) /* 32-bit RGBA PNG.*/
+#define TEXTURE_FORMAT_RGBA (1 << 3)     /* Raw 32-bit RGBA, with a .rgba.mta size file.*/
+#define TEXTURE_FORMAT_ARCHIVE (1 << 4)  /* Raw palette indices of all textures in one .tra file.*/
+
+/* The parts of a level that can be exported.*/
+#define EXPORT_ROOM_MESHES (1 << 0)
+#define EXPORT_TEXTURE_ATLASES (1 << 1)
+#define EXPORT_OBJECT_TEXTURES (1 << 2)
+
+/* The results of the library's functions.*/
+#define DIG_OK 0
+#define DIG_ERROR_INPUT 1     /* The level file couldn't be opened or read.*/
+#define DIG_ERROR_MALFORMED 2 /* The level file isn't a valid Tomb Raider 1 level.*/
+#define DIG_ERROR_OUTPUT 3    /* An output directory or file couldn't be created or written.*/
+#define DIG_ERROR_ARGUMENT 4  /* An option or argument was invalid.*/
+
+/* A level that has been opened and imported. Opaque.*/
+struct dig_level_s;
+
+/* How to import and export a level.*/
+struct dig_options_s
+{
+    /* How many threads the level may use to process its data in parallel.*/
+    unsigned numThreads;
+
+    /* The formats (MESH_FORMAT_x flags) in which to export the room meshes.*/
+    unsigned meshFormats;
+
+    /* The formats (TEXTURE_FORMAT_x flags) in which to export the textures. At
+     * most one of the PNG formats can be given.*/
+    unsigned textureFormats;
+
+    /* The parts of the level (EXPORT_x flags) to export.*/
+    unsigned exportParts;
+
+    /* Whether to export each distinct object texture image only once, into
+     * texture/image/, instead of once per object texture into texture/object/.*/
+    unsigned dedupTextures;
+
+    /* Whether to repack the texture images, each once, into a few power-of-two
+     * texture pages, exported into texture/page/ instead of the object textures.
+     * The meshes' textured faces then refer to the pages, by page index in place
+     * of object texture index, and with UV coordinates on the pages, so that all
+     * the faces on a page can share one material. The pages hold all of the
+     * level's images, whichever rooms are exported. Can't be used with
+     * dedupTextures.*/
+    unsigned repackTextures;
+
+    /* The rooms to export, as a list of indices and index ranges (e.g. "3,17-20");
+     * or NULL to export all of them. Only the object textures that the selected
+     * rooms use are then exported.*/
+    const char *roomList;
+
+    /* Whether to export each mesh used by the rooms' static objects only once,
+     * into mesh/object/, with each room listing its static objects as instances
+     * thereof, instead of baking the objects into the rooms' meshes.*/
+    unsigned instancedStatics;
+
+    /* Whether to use (and if need be, write) a table of contents sidecar next to
+     * the level file, so that the file needn't be walked through to find its
+     * sections. Not used for levels opened from memory.*/
+    unsigned useToc;
+
+    /* Whether to only write the output files whose contents have changed since
+     * the previous export, as recorded in the output's manifest.txt.*/
+    unsigned incremental;
+
+    /* Whether to import only the data that the whole level shares (the static
+     * objects' meshes, the object textures' metadata and the palette) when the
+     * level is opened, and to decode the rooms and object textures only while
+     * they're being exported: a batch of rooms, or the textures of one atlas, at
+     * a time. The parts of the level file that have been read through are also
+     * let go of. The memory used then grows with the number of rooms, whose
+     * metadata is kept, but not with the size of the level file. Can't be used
+     * with MESH_FORMAT_GLB, which needs the whole level at once.*/
+    unsigned streaming;
+
+    /* Whether to print out the level's sections as they're being read.*/
+    unsigned verbose;
+
+    /* Whether to collect statistics of the level's import and exports.*/
+    unsigned collectStats;
+};
+
+/* What a phase of importing or exporting a level did and how long it took.*/
+struct dig_phase_stats_s
+{
+    const char *name;
+    double seconds;
+    uint64_t numBytesRead;      /* From the level file.*/
+    uint64_t numBytesAllocated; /* For the level's data.*/
+    uint64_t numAllocations;
+    uint64_t numBytesWritten;   /* Into output files.*/
+    uint64_t numFilesWritten;
+    uint64_t numFaces;          /* Decoded, transformed or exported.*/
+};
+
+#define DIG_MAX_STATS_PHASES 32
+
+/* The statistics collected of a level's import and exports, phase by phase. Only
+ * the first DIG_MAX_STATS_PHASES phases are recorded.*/
+struct dig_stats_s
+{
+    uint64_t fileSize;
+    double seconds;
+
+    /* The process's peak resident set size, as of the end of the level's latest
+     * import or export. Includes any other levels being processed at the same
+     * time.*/
+    uint64_t peakResidentBytes;
+
+    unsigned numPhases;
+    struct dig_phase_stats_s phases[DIG_MAX_STATS_PHASES];
+};
+
+/* Fills the given options with the defaults: all threads, all parts, .trm meshes
+ * and .trt textures, and a table of contents sidecar.*/
+void dig_default_options(struct dig_options_s *options);
+
+/* Opens and imports the given level file. On success, points the given pointer
+ * to the level's context, to be closed with dig_close().*/
+int dig_open_file(struct dig_level_s **level, const char *filename, const struct dig_options_s *options);
+
+/* Opens and imports a level file read from the given file descriptor, which
+ * can be e.g. a pipe, to its end. The data are stored in an unlinked temporary
+ * file in $TMPDIR (or /tmp) for as long as the level is open. The given name
+ * (which can be NULL) identifies the level in messages.*/
+int dig_open_stream(struct dig_level_s **level, int fd, const char *name, const struct dig_options_s *options);
+
+/* Opens and imports a level file that's in memory. The memory isn't copied, and
+ * must stay valid until the level is closed. The given name (which can be NULL)
+ * identifies the level in messages.*/
+int dig_open_memory(struct dig_level_s **level,
+                    const void *data,
+                    size_t numBytes,
+                    const char *name,
+                    const struct dig_options_s *options);
+
+/* Exports the level into the given directory, creating it and its subdirectories
+ * as needed.*/
+int dig_export(struct dig_level_s *level, const char *outputPath);
+
+/* Returns the statistics collected so far of the level, or NULL if the level's
+ * options didn't ask for them.*/
+const struct dig_stats_s* dig_stats(const struct dig_level_s *level);
+
+/* Releases the level and all of its data.*/
+void dig_close(struct dig_level_s *level);
+
+/* Returns a description of the given DIG_OK or DIG_ERROR_x value.*/
+const char* dig_error_string(int error);
+
+#endif
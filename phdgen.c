@@ -0,0 +1,515 @@
+/*
+ * 2019 Tarpeeksi Hyvae Soft
+ *
+ * Software: phdgen
+ *
+ *
+ * Generates synthetic Tomb Raider 1 (version 32) PHD level files, for testing
+ * and benchmarking dig without the game's own level files.
+ *
+ * The rooms are filled with random geometry, textured with random rectangles of
+ * random texture atlases, and populated with static objects whose meshes are
+ * likewise random. The other sections of the file (animations, boxes, sounds,
+ * etc.) are present but nearly empty. The same options and seed always give
+ * the same file.
+ *
+ * Build with e.g. gcc -O2 -o phdgen phdgen.c.
+ *
+ * Usage: phdgen [options] <output filename>
+ *
+ *   --rooms <n>             Number of rooms (default 20; 1-65535).
+ *   --vertices <n>          Number of vertices per room (default 200;
+ *                           1-16000). Each room has half as many quads and a
+ *                           fourth as many triangles.
+ *   --statics <n>           Number of static objects per room (default 5;
+ *                           0-65535).
+ *   --meshes <n>            Number of meshes (default 30; 2-2000), half of
+ *                           which are used by the static objects.
+ *   --object-textures <n>   Number of object textures (default 300; 1-32767).
+ *   --atlases <n>           Number of texture atlases (default 4; 1-32767).
+ *   --seed <n>              Seed of the random numbers (default 12345).
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+
+/* The shape of the level to generate.*/
+struct level_params_s
+{
+    unsigned numRooms;
+    unsigned numVerticesPerRoom;
+    unsigned numStaticsPerRoom;
+    unsigned numMeshes;
+    unsigned numObjectTextures;
+    unsigned numTextureAtlases;
+    uint32_t seed;
+};
+
+/* A generated level file being written.*/
+struct level_writer_s
+{
+    FILE *file;
+    uint32_t randomState;
+};
+
+/* A growable array of 16-bit words.*/
+struct word_buffer_s
+{
+    uint16_t *data;
+    unsigned size;
+    unsigned capacity;
+};
+
+/* Returns a pseudo-random number between 0 and n-1. The generator is a plain
+ * LCG, so that a seed gives the same level on every platform.*/
+unsigned random_below(struct level_writer_s *const writer, const unsigned n)
+{
+    writer->randomState = ((writer->randomState * 1103515245u) + 12345u);
+
+    return (n? ((writer->randomState >> 8) % n) : 0);
+}
+
+void write_u8(struct level_writer_s *const writer, const unsigned value)
+{
+    fputc((value & 0xff), writer->file);
+
+    return;
+}
+
+void write_u16(struct level_writer_s *const writer, const unsigned value)
+{
+    write_u8(writer, value);
+    write_u8(writer, (value >> 8));
+
+    return;
+}
+
+void write_u32(struct level_writer_s *const writer, const uint32_t value)
+{
+    write_u16(writer, (value & 0xffff));
+    write_u16(writer, (value >> 16));
+
+    return;
+}
+
+void write_zeros(struct level_writer_s *const writer, unsigned numBytes)
+{
+    while (numBytes--)
+    {
+        write_u8(writer, 0);
+    }
+
+    return;
+}
+
+/* Writes a section of the given number of elements of the given size, each
+ * zeroed, preceded by a 32-bit count.*/
+void write_empty_section(struct level_writer_s *const writer, const unsigned count, const unsigned elementSize)
+{
+    write_u32(writer, count);
+    write_zeros(writer, (count * elementSize));
+
+    return;
+}
+
+void word_buffer_push(struct word_buffer_s *const buffer, const unsigned value)
+{
+    if (buffer->size == buffer->capacity)
+    {
+        buffer->capacity = (buffer->capacity? (buffer->capacity * 2) : 4096);
+        buffer->data = realloc(buffer->data, (sizeof(uint16_t) * buffer->capacity));
+        assert(buffer->data && "Failed to allocate memory for the mesh data.");
+    }
+
+    buffer->data[buffer->size++] = (uint16_t)value;
+
+    return;
+}
+
+void write_rooms(struct level_writer_s *const writer, const struct level_params_s *const params)
+{
+    const unsigned numVertices = params->numVerticesPerRoom;
+    const unsigned numQuads = (numVertices / 2);
+    const unsigned numTriangles = (numVertices / 4);
+    const unsigned numStaticMeshes = (params->numMeshes / 2);
+    unsigned i = 0, p = 0, v = 0;
+
+    write_u32(writer, 0); /* Unused.*/
+    write_u16(writer, params->numRooms);
+
+    for (i = 0; i < params->numRooms; i++)
+    {
+        /* Room info: x, z, bottom y and top y.*/
+        write_u32(writer, (i * 1024));
+        write_u32(writer, -(int32_t)(i * 512));
+        write_u32(writer, 0);
+        write_u32(writer, -1024);
+
+        /* The room data, whose size is given in words.*/
+        write_u32(writer, (1 + (numVertices * 4) + 1 + (numQuads * 5) + 1 + (numTriangles * 4) + 1));
+
+        write_u16(writer, numVertices);
+        for (p = 0; p < numVertices; p++)
+        {
+            write_u16(writer, (random_below(writer, 8192) - 4096));
+            write_u16(writer, (random_below(writer, 4096) - 2048));
+            write_u16(writer, random_below(writer, 8192));
+            write_u16(writer, random_below(writer, 8192)); /* Lighting.*/
+        }
+
+        /* Some of the quads are double-sided, as flagged by the texture index's
+         * top bit.*/
+        write_u16(writer, numQuads);
+        for (p = 0; p < numQuads; p++)
+        {
+            unsigned textureIdx = 0;
+
+            for (v = 0; v < 4; v++) write_u16(writer, random_below(writer, numVertices));
+
+            textureIdx = random_below(writer, params->numObjectTextures);
+            if (random_below(writer, 2)) textureIdx |= 0x8000;
+            write_u16(writer, textureIdx);
+        }
+
+        write_u16(writer, numTriangles);
+        for (p = 0; p < numTriangles; p++)
+        {
+            for (v = 0; v < 3; v++) write_u16(writer, random_below(writer, numVertices));
+            write_u16(writer, random_below(writer, params->numObjectTextures));
+        }
+
+        write_u16(writer, 0); /* Sprites.*/
+
+        write_u16(writer, 2); /* Portals.*/
+        write_zeros(writer, (2 * 32));
+
+        write_u16(writer, 3); /* Sectors, along z and x.*/
+        write_u16(writer, 2);
+        write_zeros(writer, (3 * 2 * 8));
+
+        write_u16(writer, 100); /* Ambient intensity.*/
+        write_u16(writer, 1);   /* Lights.*/
+        write_zeros(writer, 18);
+
+        /* Static objects, each referring to one of the static mesh IDs.*/
+        write_u16(writer, params->numStaticsPerRoom);
+        for (p = 0; p < params->numStaticsPerRoom; p++)
+        {
+            write_u32(writer, ((i * 1024) + random_below(writer, 1000)));
+            write_u32(writer, -(int32_t)random_below(writer, 1000));
+            write_u32(writer, random_below(writer, 1000));
+            write_u16(writer, (random_below(writer, 4) << 14)); /* Rotation.*/
+            write_u16(writer, random_below(writer, 8000));      /* Intensity.*/
+            write_u16(writer, (10 + random_below(writer, numStaticMeshes)));
+        }
+
+        write_u16(writer, 0xffff); /* Alternate room.*/
+        write_u16(writer, 0);      /* Flags.*/
+    }
+
+    return;
+}
+
+/* Writes the mesh data and the mesh pointers into it.*/
+void write_meshes(struct level_writer_s *const writer, const struct level_params_s *const params)
+{
+    struct word_buffer_s words = {NULL, 0, 0};
+    uint32_t *offsets = malloc(sizeof(uint32_t) * (params->numMeshes + 1));
+    const unsigned numColors = ((params->numObjectTextures < 256)? params->numObjectTextures : 256);
+    unsigned i = 0, p = 0, v = 0;
+
+    assert(offsets && "Failed to allocate memory for the mesh pointers.");
+
+    for (i = 0; i < params->numMeshes; i++)
+    {
+        const unsigned numVertices = (8 + random_below(writer, 40));
+        const unsigned numQuads = (numVertices / 2);
+        const unsigned numTriangles = (numVertices / 3);
+
+        offsets[i] = (words.size * 2);
+
+        /* Center and collision radius.*/
+        word_buffer_push(&words, 0);
+        word_buffer_push(&words, 0);
+        word_buffer_push(&words, 0);
+        word_buffer_push(&words, 100);
+        word_buffer_push(&words, 0);
+
+        word_buffer_push(&words, numVertices);
+        for (p = 0; p < (numVertices * 3); p++)
+        {
+            word_buffer_push(&words, (random_below(writer, 1024) - 512));
+        }
+
+        /* Every other mesh has normals, and the rest lighting.*/
+        if (i % 2)
+        {
+            word_buffer_push(&words, numVertices);
+            for (p = 0; p < (numVertices * 3); p++) word_buffer_push(&words, random_below(writer, 16384));
+        }
+        else
+        {
+            word_buffer_push(&words, -(int)numVertices);
+            for (p = 0; p < numVertices; p++) word_buffer_push(&words, random_below(writer, 8000));
+        }
+
+        #define PUSH_FACES(numFaces, numVertsPerFace, numTextures)\
+                word_buffer_push(&words, numFaces);\
+                for (p = 0; p < numFaces; p++)\
+                {\
+                    for (v = 0; v < numVertsPerFace; v++) word_buffer_push(&words, random_below(writer, numVertices));\
+                    word_buffer_push(&words, random_below(writer, numTextures));\
+                }
+
+        PUSH_FACES(numQuads, 4, params->numObjectTextures);
+        PUSH_FACES(numTriangles, 3, params->numObjectTextures);
+        PUSH_FACES(2, 4, numColors);
+        PUSH_FACES(2, 3, numColors);
+
+        #undef PUSH_FACES
+    }
+
+    write_u32(writer, words.size);
+    for (i = 0; i < words.size; i++)
+    {
+        write_u16(writer, words.data[i]);
+    }
+
+    write_u32(writer, params->numMeshes);
+    for (i = 0; i < params->numMeshes; i++)
+    {
+        write_u32(writer, offsets[i]);
+    }
+
+    free(words.data);
+    free(offsets);
+
+    return;
+}
+
+/* Writes the object textures, each a random rectangle of a random atlas. Every
+ * third one repeats the rectangle of the one before it, as happens in the game's
+ * levels.*/
+void write_object_textures(struct level_writer_s *const writer, const struct level_params_s *const params)
+{
+    unsigned prevX = 0, prevY = 0, prevWidth = 1, prevHeight = 1, prevAtlas = 0;
+    unsigned i = 0;
+
+    write_u32(writer, params->numObjectTextures);
+
+    for (i = 0; i < params->numObjectTextures; i++)
+    {
+        unsigned x = random_below(writer, 200);
+        unsigned y = random_below(writer, 200);
+        unsigned width = (1 + random_below(writer, 50));
+        unsigned height = (1 + random_below(writer, 50));
+        const unsigned attribute = random_below(writer, 3);
+        unsigned atlas = random_below(writer, params->numTextureAtlases);
+
+        if ((i % 3) == 2)
+        {
+            x = prevX;
+            y = prevY;
+            width = prevWidth;
+            height = prevHeight;
+            atlas = prevAtlas;
+        }
+
+        prevX = x;
+        prevY = y;
+        prevWidth = width;
+        prevHeight = height;
+        prevAtlas = atlas;
+
+        write_u16(writer, attribute);
+        write_u16(writer, atlas);
+
+        /* The corners, each coordinate's high byte being the texel and the low
+         * byte a sub-texel offset.*/
+        write_u16(writer, ((x << 8) | random_below(writer, 256)));
+        write_u16(writer, ((y << 8) | random_below(writer, 256)));
+        write_u16(writer, (((x + width) << 8) | random_below(writer, 256)));
+        write_u16(writer, ((y << 8) | random_below(writer, 256)));
+        write_u16(writer, (((x + width) << 8) | random_below(writer, 256)));
+        write_u16(writer, (((y + height) << 8) | random_below(writer, 256)));
+        write_u16(writer, ((x << 8) | random_below(writer, 256)));
+        write_u16(writer, (((y + height) << 8) | random_below(writer, 256)));
+    }
+
+    return;
+}
+
+void write_level(const char *const filename, const struct level_params_s *const params)
+{
+    struct level_writer_s writer;
+    unsigned i = 0;
+
+    writer.file = fopen(filename, "wb");
+    writer.randomState = params->seed;
+
+    assert(writer.file && "Failed to open the output file.");
+
+    write_u32(&writer, 32); /* Version.*/
+
+    write_u32(&writer, params->numTextureAtlases);
+    for (i = 0; i < (params->numTextureAtlases * 256 * 256); i++)
+    {
+        write_u8(&writer, random_below(&writer, 256));
+    }
+
+    write_rooms(&writer, params);
+
+    write_u32(&writer, 5); /* Floor data.*/
+    write_zeros(&writer, (5 * 2));
+
+    write_meshes(&writer, params);
+
+    write_empty_section(&writer, 3, 32);  /* Animations.*/
+    write_empty_section(&writer, 2, 6);   /* State changes.*/
+    write_empty_section(&writer, 1, 8);   /* Animation dispatches.*/
+    write_empty_section(&writer, 4, 2);   /* Animation commands.*/
+    write_empty_section(&writer, 2, 4);   /* Mesh trees.*/
+    write_empty_section(&writer, 10, 2);  /* Frames.*/
+    write_empty_section(&writer, 2, 18);  /* Models.*/
+
+    /* Static meshes, with IDs from 10 up, using the last half of the meshes.*/
+    write_u32(&writer, (params->numMeshes / 2));
+    for (i = 0; i < (params->numMeshes / 2); i++)
+    {
+        write_u32(&writer, (10 + i));
+        write_u16(&writer, (params->numMeshes - 1 - i));
+        write_zeros(&writer, (12 + 12 + 2)); /* Visibility and collision boxes, and flags.*/
+    }
+
+    write_object_textures(&writer, params);
+
+    write_empty_section(&writer, 2, 16);  /* Sprite textures.*/
+    write_empty_section(&writer, 1, 8);   /* Sprite sequences.*/
+    write_empty_section(&writer, 1, 16);  /* Cameras.*/
+    write_empty_section(&writer, 1, 16);  /* Sound sources.*/
+    write_empty_section(&writer, 3, 20);  /* Boxes.*/
+    write_empty_section(&writer, 4, 2);   /* Overlaps.*/
+    write_zeros(&writer, (3 * 2 * 6));    /* Zones, six words per box.*/
+    write_empty_section(&writer, 1, 2);   /* Animated textures.*/
+    write_empty_section(&writer, 2, 22);  /* Entities.*/
+    write_zeros(&writer, 8192);           /* Light map.*/
+
+    /* The palette, in VGA 6-bit color.*/
+    for (i = 0; i < 768; i++)
+    {
+        write_u8(&writer, random_below(&writer, 64));
+    }
+
+    write_u16(&writer, 1);               /* Cinematic frames.*/
+    write_zeros(&writer, 16);
+    write_u16(&writer, 3);               /* Demo data.*/
+    write_zeros(&writer, 3);
+    write_zeros(&writer, (256 * 2));     /* Sound map.*/
+    write_empty_section(&writer, 0, 8);  /* Sound details.*/
+    write_empty_section(&writer, 0, 1);  /* Samples.*/
+    write_empty_section(&writer, 0, 4);  /* Sample indices.*/
+
+    assert(!ferror(writer.file) && "Failed to write into the output file.");
+    fclose(writer.file);
+
+    return;
+}
+
+void print_usage(const char *const programName)
+{
+    printf("Usage: %s [options] <output filename>\n"
+           "\n"
+           "Generates a synthetic Tomb Raider 1 level file.\n"
+           "\n"
+           "  --rooms <n>             Number of rooms (default 20; 1-65535).\n"
+           "  --vertices <n>          Number of vertices per room (default 200;\n"
+           "                          1-16000).\n"
+           "  --statics <n>           Number of static objects per room (default 5;\n"
+           "                          0-65535).\n"
+           "  --meshes <n>            Number of meshes (default 30; 2-2000).\n"
+           "  --object-textures <n>   Number of object textures (default 300;\n"
+           "                          1-32767).\n"
+           "  --atlases <n>           Number of texture atlases (default 4; 1-32767).\n"
+           "  --seed <n>              Seed of the random numbers (default 12345).\n", programName);
+
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *const optionNames[] = {"--rooms", "--vertices", "--statics", "--meshes",
+                                       "--object-textures", "--atlases", "--seed"};
+    struct level_params_s params;
+    const char *filename = NULL;
+    unsigned *const options[] = {&params.numRooms, &params.numVerticesPerRoom, &params.numStaticsPerRoom,
+                                 &params.numMeshes, &params.numObjectTextures, &params.numTextureAtlases,
+                                 NULL};
+    int i = 0;
+
+    params.numRooms = 20;
+    params.numVerticesPerRoom = 200;
+    params.numStaticsPerRoom = 5;
+    params.numMeshes = 30;
+    params.numObjectTextures = 300;
+    params.numTextureAtlases = 4;
+    params.seed = 12345;
+
+    for (i = 1; i < argc; i++)
+    {
+        unsigned optionIdx = 0;
+
+        for (optionIdx = 0; optionIdx < (sizeof(optionNames) / sizeof(optionNames[0])); optionIdx++)
+        {
+            if (strcmp(argv[i], optionNames[optionIdx]) == 0)
+            {
+                break;
+            }
+        }
+
+        if (optionIdx == (sizeof(optionNames) / sizeof(optionNames[0])))
+        {
+            /* E.g. --help, rather than a filename.*/
+            if (argv[i][0] == '-')
+            {
+                print_usage(argv[0]);
+                return 1;
+            }
+
+            filename = argv[i];
+        }
+        else if ((i + 1) >= argc)
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+        else if (options[optionIdx])
+        {
+            *options[optionIdx] = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            params.seed = strtoul(argv[++i], NULL, 10);
+        }
+    }
+
+    /* Rooms' vertex indices and the mesh data are 16-bit.*/
+    if (!filename ||
+        (params.numVerticesPerRoom < 1) || (params.numVerticesPerRoom > 16000) ||
+        (params.numRooms < 1) || (params.numRooms > 65535) ||
+        (params.numMeshes < 2) || (params.numMeshes > 2000) ||
+        (params.numObjectTextures < 1) || (params.numObjectTextures > 32767) ||
+        (params.numTextureAtlases < 1) || (params.numTextureAtlases > 32767) ||
+        (params.numStaticsPerRoom > 65535))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    write_level(filename, &params);
+
+    return 0;
+}